@@ -0,0 +1,20 @@
+#version 450 core
+
+// global set, every texture of the scene (MAX_TEXTURES in Descriptors.h), one layer per grass species
+layout(set = 0, binding = 0) uniform sampler2DArray textures[16];
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) flat in uint layer;
+layout(location = 2) flat in uint textureIndex; // the same for a whole draw
+
+// never written to the color target, the alpha feeds alpha to coverage when multisampling
+layout(location = 0) out vec4 color;
+
+void main()
+{
+  // alpha test only, the color pass shades the surviving fragments with an equal depth test
+  color = texture(textures[textureIndex], vec3(fragTexCoord, layer));
+#ifndef NO_DISCARD
+  if (color.w < 1) { discard; }
+#endif
+}
@@ -1,23 +1,21 @@
 #version 450 core
 
-layout(binding = 0) uniform sampler2D texSampler;
+// global set, every texture of the scene (MAX_TEXTURES in Descriptors.h), one layer per grass species
+layout(set = 0, binding = 0) uniform sampler2DArray textures[16];
 
 layout(location = 0) in vec2 fragTexCoord;
-layout(location = 1) in vec2 id;
+layout(location = 1) flat in uint layer;
+layout(location = 2) flat in uint textureIndex; // the same for a whole draw
 
 layout(location = 0) out vec4 color;
 
 
 void main()
 {
-  if (fragTexCoord.x < 0 && id.x == 0) {
-    color = vec4(0.6, 0.3, 0, 1);
-  } else if(fragTexCoord.x < 0) {
-    color = vec4(0, 0, 0, 0);
-  } else {
-    color = texture(texSampler, fragTexCoord);
-  } 
+  color = texture(textures[textureIndex], vec3(fragTexCoord, layer));
+#ifndef NO_DISCARD
   if (color.w < 1) { discard; }
+#endif
 
 
 
@@ -0,0 +1,13 @@
+#version 450 core
+
+// specialization constants, see SceneConstants in VulkanApp.h
+layout(constant_id = 5) const float GROUND_R = 0.6;
+layout(constant_id = 6) const float GROUND_G = 0.3;
+layout(constant_id = 7) const float GROUND_B = 0.0;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+  color = vec4(GROUND_R, GROUND_G, GROUND_B, 1);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout(location = 0) in vec2 vertex;
+
+// frame set, the dynamic offset selects the slice of the frame in flight
+layout(set = 1, binding = 0) uniform UniformBufferObject
+{
+  vec4 field;          // w - ground half extent
+  vec4 positionBounds; // xy - min, zw - extent
+  vec4 texCoordBounds;
+} ubo;
+
+// per frame: viewProj, time; per draw: origin, lod, textureSlot (PushConstants in DrawList.h)
+layout(push_constant) uniform PushConstants
+{
+  mat4  viewProj;
+  float time;
+  vec2  origin;
+  uint  lod;
+  uint  textureSlot;
+} pc;
+
+// the depth prepass and the equal depth color pass must produce bit identical depth
+invariant gl_Position;
+
+void main(void)
+{
+  // the quad corners are at +-1, the draw origin is the center of the streamed field
+  vec2 corner = ubo.positionBounds.xy + vertex * ubo.positionBounds.zw;
+  vec4 pos = vec4(pc.origin.x + corner.x * ubo.field.w, 0, pc.origin.y + corner.y * ubo.field.w, 1.0);
+  gl_Position = pc.viewProj * pos;
+}
@@ -1,47 +1,133 @@
 #version 450
 
+// specialization constants, see SceneConstants in VulkanApp.h
+layout(constant_id = 0) const float WIND_PERIOD    = 75.0;
+layout(constant_id = 1) const float WIND_SPATIAL   = 17.0;
+layout(constant_id = 2) const float WIND_FREQUENCY = 10.0;
+layout(constant_id = 3) const float WIND_AMPLITUDE = 0.1;
+layout(constant_id = 4) const float BLADE_SCALE    = 0.5;
+
 layout(location = 0) in vec2 vertex;
 layout(location = 1) in vec2 texCoord;
+layout(location = 2) in uint instanceId;
 
-layout(binding = 1) uniform UniformBufferObject
+// frame set, the dynamic offset selects the slice of the frame in flight
+layout(set = 1, binding = 0) uniform UniformBufferObject
 {
-  mat4 model;
-  mat4 view;
-  mat4 proj;
-  float time;
+  vec4 field;          // w - ground half extent
+  vec4 positionBounds; // xy - min, zw - extent
+  vec4 texCoordBounds;
+  vec4 wind;           // x - wind field repeats per world unit
+  uvec4 animation;     // x - vertex animation texture slot, y - frames in its loop
 } ubo;
 
+// per frame: viewProj, time; per draw: origin, lod, textureSlot (PushConstants in DrawList.h)
+layout(push_constant) uniform PushConstants
+{
+  mat4  viewProj;
+  float time;
+  vec2  origin;
+  uint  lod;
+  uint  textureSlot;
+} pc;
+
+struct Blade
+{
+  float x;
+  float z;
+  float scale;
+  uint  variation; // species in the low 8 bits, wind phase in the upper 24 (BladeInstance in GrassField.h)
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer BladePool
+{
+  Blade blades[];
+};
+
+// lean and lean velocity from simulate.comp, the dynamic offset selects the half written for this frame
+layout(std430, set = 1, binding = 2) readonly buffer BladeState
+{
+  vec2 bladeState[];
+};
+
+// x - strength, y - turbulence, written by WindField for this frame, the dynamic offset selects it
+layout(std430, set = 1, binding = 3) readonly buffer WindField
+{
+  vec2 wind[];
+};
+
+const float PHASE_STEP = 500.0 / 16777216.0; // PHASE_RANGE / 2^24
+const int   WIND_FIELD_SIZE = 64;            // WIND_FIELD_SIZE in WindField.h
+
+// bilinear between texel centers, the field repeats across the ground
+vec2 sampleWind(vec2 world)
+{
+  vec2  t = world * ubo.wind.x * WIND_FIELD_SIZE - 0.5;
+  ivec2 i = ivec2(floor(t));
+  vec2  f = t - vec2(i);
+  ivec2 a = i & (WIND_FIELD_SIZE - 1);
+  ivec2 b = (i + 1) & (WIND_FIELD_SIZE - 1);
+  vec2 row0 = mix(wind[a.y * WIND_FIELD_SIZE + a.x], wind[a.y * WIND_FIELD_SIZE + b.x], f.x);
+  vec2 row1 = mix(wind[b.y * WIND_FIELD_SIZE + a.x], wind[b.y * WIND_FIELD_SIZE + b.x], f.x);
+  return mix(row0, row1, f.y);
+}
+
+#ifdef VERTEX_ANIMATION
+// one loop of the flutter per vertex baked by VertexAnimation, row f is frame f, the column is the vertex
+layout(set = 0, binding = 0) uniform sampler2DArray textures[16];
+
+const float TWO_PI = 6.28318530718;
+
+// the loop is one wind period, blended between the two nearest frames
+float bakedFlutter(float time)
+{
+  int   frames = int(ubo.animation.y);
+  float t = fract(time / (TWO_PI * WIND_PERIOD)) * float(frames);
+  int   f0 = min(int(t), frames - 1);
+  int   f1 = f0 + 1 == frames ? 0 : f0 + 1;
+  float a = texelFetch(textures[ubo.animation.x], ivec3(gl_VertexIndex, f0, 0), 0).x;
+  float b = texelFetch(textures[ubo.animation.x], ivec3(gl_VertexIndex, f1, 0), 0).x;
+  return mix(a, b, t - float(f0));
+}
+#endif
 
 layout(location = 0) out vec2 coordTex;
-layout(location = 1) out vec2 id;
+layout(location = 1) flat out uint layer;
+layout(location = 2) flat out uint textureIndex;
+
+// the depth prepass and the equal depth color pass must produce bit identical depth
+invariant gl_Position;
 
 void main(void)
 {
-  vec4 pos = vec4(vertex, 0, 1.0);
-  if (gl_VertexIndex < 4) {
-    if(gl_VertexIndex < 2) {
-      pos.z = -2;
-    } else {
-      pos.z = 6;
-    }
-  } else {
-    pos.xy /= 2;
-
-    float len = pos.y;
-    pos.z += sin((ubo.time + 5 * gl_InstanceIndex + 17 * pos.x) / 75 + pos.y * 10) / 10 * pos.y;
-    //float angle = pos.y + ubo.time / 90;
-    //pos.y += len * asin(angle);
-
-    vec3 offset = vec3(-1.95, 0, -1.95); 
-    pos.xyz += offset;
-    pos.z += 0.78 * (gl_InstanceIndex % 10);
-    int shift = gl_InstanceIndex / 10;
-    pos.x += 0.39 * shift;
-    //pos.z = 6 - 0.7. * gl_InstanceIndex;
-    //pos.y = -pos.y + 1;
-  }
+  int instance = int(instanceId);
+  vec4 pos = vec4(ubo.positionBounds.xy + vertex * ubo.positionBounds.zw, 0, 1.0);
+  Blade blade = blades[instance];
+  float phase = float(blade.variation >> 8) * PHASE_STEP;
+  pos.xy *= BLADE_SCALE * blade.scale;
+
+  float len = pos.y;
+#ifdef VERTEX_ANIMATION
+  // far blades play the baked flutter from their own phase, the wind field only reaches them
+  // through the lean
+  pos.z += bakedFlutter(pc.time + phase) * WIND_AMPLITUDE * pos.y;
+#else
+  // the flutter is scaled by the wind strength where the blade stands, and the turbulence shifts its
+  // phase so neighbours stay coherent without moving in lockstep; simulate.comp leans the blade
+  vec2 local = sampleWind(vec2(blade.x, blade.z));
+  pos.z += sin((pc.time + phase + WIND_SPATIAL * pos.x) / WIND_PERIOD + pos.y * WIND_FREQUENCY + 3.0 * local.y) 
+           * WIND_AMPLITUDE * (0.5 + local.x) * pos.y;
+#endif
+  pos.z += bladeState[instance].x * pos.y;
+  //float angle = pos.y + ubo.time / 90;
+  //pos.y += len * asin(angle);
+
+  // the blade pool is in world space, the grass draws push a zero origin
+  pos.x += pc.origin.x + blade.x;
+  pos.z += pc.origin.y + blade.z;
   
-  gl_Position = ubo.proj * ubo.view * ubo.model * pos;
-  coordTex = texCoord;   
-  id = vec2(gl_InstanceIndex, gl_InstanceIndex);
+  gl_Position = pc.viewProj * pos;
+  coordTex = ubo.texCoordBounds.xy + texCoord * ubo.texCoordBounds.zw;
+  layer = blade.variation & 0xffu;
+  textureIndex = pc.textureSlot;
 }
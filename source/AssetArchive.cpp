@@ -0,0 +1,87 @@
+#include "AssetArchive.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+static uint64_t alignArchive(uint64_t offset)
+{
+    return (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+}
+
+AssetArchive::AssetArchive(const std::string& path) : file(path)
+{
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(file.data());
+    ArchiveHeader header;
+    if (file.size() < sizeof(header))
+        throw std::runtime_error("AssetArchive: " + path + " is too small");
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ARCHIVE_VERSION)
+        throw std::runtime_error("AssetArchive: " + path + " is not a version " + std::to_string(ARCHIVE_VERSION) + " archive");
+    if (sizeof(header) + uint64_t(header.entryCount) * sizeof(ArchiveEntry) > file.size())
+        throw std::runtime_error("AssetArchive: " + path + " has a truncated table of contents");
+
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        ArchiveEntry entry;
+        memcpy(&entry, base + sizeof(header) + i * sizeof(ArchiveEntry), sizeof(entry));
+        entry.name[ARCHIVE_NAME_SIZE - 1] = '\0';
+        if (entry.offset % ARCHIVE_ALIGNMENT != 0 || entry.offset > file.size() || entry.size > file.size() - entry.offset)
+            throw std::runtime_error("AssetArchive: " + path + ": " + entry.name + " is outside the archive");
+        spans[entry.name] = { base + entry.offset, size_t(entry.size), entry.kind, entry.width, entry.height };
+    }
+}
+
+const AssetSpan* AssetArchive::find(const std::string& name) const
+{
+    auto it = spans.find(name);
+    return it != spans.end() ? &it->second : nullptr;
+}
+
+void ArchiveWriter::add(const std::string& name, AssetKind kind, const void* data, size_t size, uint32_t width, uint32_t height)
+{
+    std::string key = std::filesystem::path(name).lexically_normal().generic_string();
+    if (key.size() >= ARCHIVE_NAME_SIZE)
+        throw std::runtime_error("ArchiveWriter: name too long " + key);
+
+    Blob blob = {};
+    memcpy(blob.entry.name, key.c_str(), key.size());
+    blob.entry.kind   = kind;
+    blob.entry.width  = width;
+    blob.entry.height = height;
+    blob.entry.size   = size;
+    blob.bytes.assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    blobs.push_back(std::move(blob));
+}
+
+void ArchiveWriter::write(const std::string& path) const
+{
+    ArchiveHeader header = {};
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version    = ARCHIVE_VERSION;
+    header.entryCount = uint32_t(blobs.size());
+
+    // blobs follow the table in the order they were added, the loader reads front to back
+    std::vector<ArchiveEntry> entries;
+    uint64_t offset = alignArchive(sizeof(header) + blobs.size() * sizeof(ArchiveEntry));
+    for (const Blob& blob : blobs) {
+        entries.push_back(blob.entry);
+        entries.back().offset = offset;
+        offset = alignArchive(offset + blob.bytes.size());
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open())
+        throw std::runtime_error("ArchiveWriter: can't create " + path);
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(ArchiveEntry)));
+    uint64_t written = sizeof(header) + entries.size() * sizeof(ArchiveEntry);
+    for (size_t i = 0; i < blobs.size(); i++) {
+        out.write(padding, std::streamsize(entries[i].offset - written));
+        out.write(reinterpret_cast<const char*>(blobs[i].bytes.data()), std::streamsize(blobs[i].bytes.size()));
+        written = entries[i].offset + blobs[i].bytes.size();
+    }
+    if (!out)
+        throw std::runtime_error("ArchiveWriter: failed to write " + path);
+}
@@ -0,0 +1,99 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "NumberReader.h"
+
+// Layout: ArchiveHeader, entryCount ArchiveEntry records, then the blobs, each starting on an
+// ARCHIVE_ALIGNMENT boundary so floats, indices and SPIR-V words can be used in place.
+const char     ARCHIVE_MAGIC[4]  = { 'G', 'P', 'A', 'K' };
+const uint32_t ARCHIVE_VERSION   = 1;
+const uint32_t ARCHIVE_ALIGNMENT = 64;
+const uint32_t ARCHIVE_NAME_SIZE = 64;
+
+enum class AssetKind : uint32_t
+{
+    Raw,        // bytes of the source file, SPIR-V
+    Floats,     // parsed float text
+    Indices16,  // parsed index text
+    ImageRGBA8, // decoded image, width * height * 4 bytes
+};
+
+struct ArchiveHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct ArchiveEntry
+{
+    char      name[ARCHIVE_NAME_SIZE]; // normalized source path, zero terminated
+    AssetKind kind;
+    uint32_t  width;                   // images only
+    uint32_t  height;
+    uint32_t  reserved;
+    uint64_t  offset;                  // from the start of the archive
+    uint64_t  size;
+};
+
+// a blob inside the mapped archive, valid as long as the archive is
+struct AssetSpan
+{
+    const unsigned char* data;
+    size_t               size;
+    AssetKind            kind;
+    uint32_t             width;
+    uint32_t             height;
+
+    template <typename T>
+    const T* as() const { return reinterpret_cast<const T*>(data); }
+    template <typename T>
+    size_t   count() const { return size / sizeof(T); }
+};
+
+// Baked assets of one archive file, mapped once and handed out without copies.
+class AssetArchive
+{
+public:
+    // throws std::runtime_error when the file can't be opened or is not a valid archive
+    explicit AssetArchive(const std::string& path);
+
+    // nullptr when the archive has no asset baked from that path
+    const AssetSpan* find(const std::string& name) const;
+    uint32_t         size() const  { return uint32_t(spans.size()); }
+    uint64_t         bytes() const { return file.size(); }
+
+private:
+    MappedFile                                 file;
+    std::unordered_map<std::string, AssetSpan> spans;
+};
+
+// Collects blobs and writes them as an archive, used by the asset_bake tool.
+class ArchiveWriter
+{
+public:
+    // name is a source path, it is normalized the way AssetCache normalizes paths
+    void add(const std::string& name, AssetKind kind, const void* data, size_t size, uint32_t width = 0, uint32_t height = 0);
+    // throws std::runtime_error when the file can't be written
+    void write(const std::string& path) const;
+
+private:
+    struct Blob
+    {
+        ArchiveEntry               entry;
+        std::vector<unsigned char> bytes;
+    };
+
+    std::vector<Blob> blobs;
+};
+
+#endif //ASSET_ARCHIVE_H
@@ -0,0 +1,82 @@
+// asset_bake <archive> [scene.json] [shader directory]
+// Packs the mesh, the species textures and the SPIR-V of a scene into one archive. Text is parsed
+// and images decoded here, so the app only maps the archive. Paths are resolved like the app
+// resolves them, run it from the build directory.
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <set>
+
+#include "AssetArchive.h"
+#include "SceneConfig.h"
+#include "NumberReader.h"
+#include "JobSystem.h"
+
+static void bake(const std::string& archivePath, const std::string& scenePath, const std::string& shaderDirectory)
+{
+    JobSystem   jobs;
+    AssetCache  assets;
+    SceneConfig config = loadSceneConfig(scenePath, assets);
+    ArchiveWriter writer;
+    uint64_t sourceBytes = 0;
+
+    std::vector<float> vertices;
+    std::vector<uint16_t> indices;
+    NumberReadStats vertexStats, indexStats;
+    readNumbers(jobs, assets.path(config.vertices), vertices, &vertexStats);
+    readNumbers(jobs, assets.path(config.indices), indices, &indexStats);
+    writer.add(assets.path(config.vertices), AssetKind::Floats, vertices.data(), vertices.size() * sizeof(float));
+    writer.add(assets.path(config.indices), AssetKind::Indices16, indices.data(), indices.size() * sizeof(uint16_t));
+    sourceBytes += vertexStats.bytes + indexStats.bytes;
+
+    // species usually share a source image, it is decoded once
+    std::set<AssetId> textures;
+    for (const SpeciesConfig& species : config.species)
+        textures.insert(species.texture);
+    for (AssetId texture : textures) {
+        const std::vector<unsigned char>& bytes = assets.bytes(texture);
+        int w, h, c;
+        unsigned char* pixels = stbi_load_from_memory(bytes.data(), int(bytes.size()), &w, &h, &c, STBI_rgb_alpha);
+        if (pixels == nullptr)
+            throw std::runtime_error("bake: can't decode " + assets.path(texture));
+        writer.add(assets.path(texture), AssetKind::ImageRGBA8, pixels, size_t(w) * h * 4, uint32_t(w), uint32_t(h));
+        stbi_image_free(pixels);
+        sourceBytes += bytes.size();
+    }
+
+    // sorted so the archive does not change with the directory order
+    std::vector<std::filesystem::path> shaders;
+    for (const auto& entry : std::filesystem::directory_iterator(shaderDirectory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".spv")
+            shaders.push_back(entry.path());
+    }
+    std::sort(shaders.begin(), shaders.end());
+    for (const std::filesystem::path& shader : shaders) {
+        const std::vector<unsigned char>& code = assets.bytes(assets.add(shader.string()));
+        writer.add(shader.string(), AssetKind::Raw, code.data(), code.size());
+        sourceBytes += code.size();
+    }
+
+    writer.write(archivePath);
+    AssetArchive archive(archivePath);
+    std::cout << archivePath << ": " << archive.size() << " assets, " << archive.bytes() << " bytes from "
+              << sourceBytes << " source bytes" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: asset_bake <archive> [scene.json] [shader directory]" << std::endl;
+        return 1;
+    }
+    try {
+        bake(argv[1], argc > 2 ? argv[2] : "", argc > 3 ? argv[3] : "../shaders");
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
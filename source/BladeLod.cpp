@@ -0,0 +1,140 @@
+#include "BladeLod.h"
+
+#include <iomanip>
+#include <algorithm>
+
+// ids per job in select, a few microseconds of work each
+const uint32_t SELECT_BATCH = 4096;
+
+MeshRange appendGridMesh(uint32_t cols, uint32_t rows, std::vector<float>& vertices, std::vector<uint16_t>& indices)
+{
+    MeshRange range;
+    range.firstIndex   = uint32_t(indices.size());
+    range.vertexOffset = int32_t(vertices.size() / VERTEX_FLOATS);
+    range.vertexCount  = cols * rows;
+
+    for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i < cols; i++) {
+            float x = float(i) / float(cols - 1);
+            float y = float(j) / float(rows - 1);
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(1.0f - x);
+            vertices.push_back(1.0f - y);
+        }
+    }
+
+    auto lin = [cols](uint32_t i, uint32_t j) { return uint16_t(j * cols + i); };
+    for (uint32_t j = 0; j + 1 < rows; j++) {
+        for (uint32_t i = 0; i + 1 < cols; i++) {
+            indices.push_back(lin(i, j));
+            indices.push_back(lin(i + 1, j));
+            indices.push_back(lin(i, j + 1));
+
+            indices.push_back(lin(i + 1, j + 1));
+            indices.push_back(lin(i, j + 1));
+            indices.push_back(lin(i + 1, j));
+        }
+    }
+
+    range.indexCount = uint32_t(indices.size()) - range.firstIndex;
+    return range;
+}
+
+void BladeLodChain::build(const MeshRange& fullRes, const BladeLodSettings& settings, std::vector<float>& vertices, 
+                          std::vector<uint16_t>& indices)
+{
+    hysteresis = settings.hysteresis;
+    levels.clear();
+    levels.push_back({33, 33, settings.minScreenHeight[0], fullRes});
+    levels.push_back({17, 17, settings.minScreenHeight[1], {}});
+    levels.push_back({ 9,  9, settings.minScreenHeight[2], {}});
+    levels.push_back({ 3,  5, settings.minScreenHeight[3], {}});
+
+    for (size_t i = 1; i < levels.size(); i++)
+        levels[i].range = appendGridMesh(levels[i].cols, levels[i].rows, vertices, indices);
+
+    offsets.assign(levels.size() + 1, 0);
+}
+
+uint8_t BladeLodChain::pickLevel(uint8_t lod, float screenHeight) const
+{
+    const uint8_t last = uint8_t(levels.size() - 1);
+    if (lod > last) {
+        // first time we see this instance, no hysteresis
+        lod = 0;
+        while (lod < last && screenHeight < levels[lod].minScreenHeight)
+            lod++;
+        return lod;
+    }
+
+    while (lod < last && screenHeight < levels[lod].minScreenHeight * (1.0f - hysteresis))
+        lod++;
+    while (lod > 0 && screenHeight > levels[lod - 1].minScreenHeight * (1.0f + hysteresis))
+        lod--;
+    return lod;
+}
+
+void BladeLodChain::select(JobSystem& jobs, const std::vector<uint32_t>& ids, const std::vector<glm::vec3>& centers, 
+                           const glm::mat4& viewProj, float focalPixels, float bladeHeight)
+{
+    if (currentLod.size() != centers.size())
+        currentLod.assign(centers.size(), 0xFF);
+
+    const uint32_t idCount = uint32_t(ids.size());
+    const size_t   levelCount = levels.size();
+    uint32_t batches = (idCount + SELECT_BATCH - 1) / SELECT_BATCH;
+    batchCounts.assign(batches * levelCount, 0);
+
+    // ids are unique, so every batch writes its own currentLod entries
+    jobs.parallelFor(idCount, SELECT_BATCH, [&](uint32_t begin, uint32_t end) {
+        uint32_t* counts = &batchCounts[begin / SELECT_BATCH * levelCount];
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t id = ids[i];
+            glm::vec4 clip = viewProj * glm::vec4(centers[id], 1.0f);
+            float screenHeight = clip.w > 0.0f ? bladeHeight * focalPixels / clip.w : 0.0f;
+            currentLod[id] = pickLevel(currentLod[id], screenHeight);
+            counts[currentLod[id]]++;
+        }
+    });
+
+    // turn the counts into where each batch starts writing in each bucket, in id order
+    offsets[0] = 0;
+    for (size_t lod = 0; lod < levelCount; lod++) {
+        uint32_t cursor = offsets[lod];
+        for (uint32_t batch = 0; batch < batches; batch++) {
+            uint32_t count = batchCounts[batch * levelCount + lod];
+            batchCounts[batch * levelCount + lod] = cursor;
+            cursor += count;
+        }
+        offsets[lod + 1] = cursor;
+    }
+
+    instances.resize(idCount);
+    jobs.parallelFor(idCount, SELECT_BATCH, [&](uint32_t begin, uint32_t end) {
+        uint32_t* cursor = &batchCounts[begin / SELECT_BATCH * levelCount];
+        for (uint32_t i = begin; i < end; i++)
+            instances[cursor[currentLod[ids[i]]]++] = ids[i];
+    });
+}
+
+void BladeLodChain::reset(uint32_t first, uint32_t count)
+{
+    if (first + count <= currentLod.size())
+        std::fill(currentLod.begin() + first, currentLod.begin() + first + count, 0xFF);
+}
+
+void BladeLodChain::report(std::ostream& out) const
+{
+    uint64_t totalVertices = 0;
+    for (size_t lod = 0; lod < levels.size(); lod++) {
+        uint64_t vertices = uint64_t(bucketSize(lod)) * levels[lod].range.vertexCount;
+        uint64_t invocations = uint64_t(bucketSize(lod)) * levels[lod].range.indexCount;
+        totalVertices += vertices;
+        out << "LOD " << lod << " (" << levels[lod].cols << "x" << levels[lod].rows << "): "
+            << std::setw(5) << bucketSize(lod) << " instances, "
+            << std::setw(8) << vertices << " vertices, "
+            << std::setw(8) << invocations << " indices" << std::endl;
+    }
+    out << "LOD total: " << totalVertices << " vertices per frame" << std::endl;
+}
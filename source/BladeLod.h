@@ -0,0 +1,67 @@
+#ifndef BLADE_LOD_H
+#define BLADE_LOD_H
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "Mesh.h"
+#include "JobSystem.h"
+
+struct BladeLodLevel
+{
+    uint32_t  cols;
+    uint32_t  rows;
+    float     minScreenHeight; // projected blade height in pixels below which the next level is used
+    MeshRange range;
+};
+
+const uint32_t BLADE_LOD_LEVELS = 4;
+
+struct BladeLodSettings
+{
+    // projected height in pixels below which each level hands over to the next, the last is never left
+    float minScreenHeight[BLADE_LOD_LEVELS] = { 120.0f, 60.0f, 25.0f, 0.0f };
+    float hysteresis = 0.15f;
+};
+
+class BladeLodChain
+{
+public:
+    BladeLodChain() : hysteresis(0.15f) {};
+
+    // fullRes is the blade loaded from file; coarser grids are appended to vertices/indices
+    void build(const MeshRange& fullRes, const BladeLodSettings& settings, std::vector<float>& vertices, std::vector<uint16_t>& indices);
+    // ids index into centers; focalPixels = proj[1][1] * viewportHeight / 2, i.e. pixels per world unit at unit depth.
+    // batches of ids are classified and bucketed in parallel, the result is the same as a serial pass
+    void select(JobSystem& jobs, const std::vector<uint32_t>& ids, const std::vector<glm::vec3>& centers, 
+                const glm::mat4& viewProj, float focalPixels, float bladeHeight);
+    // forget the lod history of instances whose slot was reused
+    void reset(uint32_t first, uint32_t count);
+    void report(std::ostream& out) const;
+
+    size_t                       levelCount() const            { return levels.size(); }
+    const BladeLodLevel&         level(size_t lod) const       { return levels[lod]; }
+    uint32_t                     bucketOffset(size_t lod) const { return offsets[lod]; }
+    uint32_t                     bucketSize(size_t lod) const   { return offsets[lod + 1] - offsets[lod]; }
+    // instance ids grouped by lod, bucket i occupies [bucketOffset(i), bucketOffset(i) + bucketSize(i))
+    const std::vector<uint32_t>& bucketedInstances() const     { return instances; }
+
+private:
+    float                      hysteresis;
+    std::vector<BladeLodLevel> levels;
+    std::vector<uint8_t>       currentLod;
+    std::vector<uint32_t>      offsets;
+    std::vector<uint32_t>      instances;
+    // per batch of ids, the count of each level and then the write cursor of each level
+    std::vector<uint32_t>      batchCounts;
+
+    uint8_t pickLevel(uint8_t lod, float screenHeight) const;
+};
+
+// appends a cols x rows blade grid laid out like utils/utils.ipynb, indices are local to the range
+MeshRange appendGridMesh(uint32_t cols, uint32_t rows, std::vector<float>& vertices, std::vector<uint16_t>& indices);
+
+#endif //BLADE_LOD_H
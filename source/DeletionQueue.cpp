@@ -0,0 +1,24 @@
+#include "DeletionQueue.h"
+
+void DeletionQueue::push(uint64_t lastUse, std::function<void()> destroy)
+{
+    // a late tag still has to wait for everything queued before it
+    if (!entries.empty() && lastUse < entries.back().first)
+        lastUse = entries.back().first;
+    entries.emplace_back(lastUse, std::move(destroy));
+}
+
+void DeletionQueue::collect(uint64_t completedFrame)
+{
+    while (!entries.empty() && entries.front().first <= completedFrame) {
+        entries.front().second();
+        entries.pop_front();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    for (auto& entry : entries)
+        entry.second();
+    entries.clear();
+}
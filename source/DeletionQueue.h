@@ -0,0 +1,45 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+#include "VulkanHandle.h"
+
+// Objects retired while frames in flight may still reference them. Each entry is tagged with
+// the last frame that may use it and destroyed by collect() once that frame has completed,
+// so pipelines, attachments or buffers can be replaced at any frame without a device wait.
+class DeletionQueue
+{
+public:
+    DeletionQueue() {}
+    ~DeletionQueue() { flush(); }
+
+    void push(uint64_t lastUse, std::function<void()> destroy);
+
+    template <typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+    void retire(uint64_t lastUse, DeviceHandle<T, Destroy>&& handle)
+    {
+        if (!handle)
+            return;
+        VkDevice device = handle.owner();
+        T        object = handle.release();
+        push(lastUse, [device, object]() { DeviceHandle<T, Destroy>::destroy(device, object); });
+    }
+
+    // destroys everything whose last frame is <= completedFrame
+    void collect(uint64_t completedFrame);
+    // destroys everything, the device must be idle
+    void flush();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    // ordered by frame, so collect stops at the first entry still in use
+    std::deque<std::pair<uint64_t, std::function<void()>>> entries;
+};
+
+#endif //DELETION_QUEUE_H
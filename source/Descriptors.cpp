@@ -0,0 +1,235 @@
+#include "Descriptors.h"
+
+#include <stdexcept>
+
+DescriptorManager::DescriptorManager() :
+    device(VK_NULL_HANDLE), descriptorIndexing(false), setLayouts{ { VK_NULL_HANDLE, VK_NULL_HANDLE } },
+    globalPool(VK_NULL_HANDLE), framePool(VK_NULL_HANDLE), globalSet(VK_NULL_HANDLE), frameSet(VK_NULL_HANDLE)
+{
+}
+
+static VkDescriptorPool createPool(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizes,
+                                   uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
+{
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = flags;
+    poolInfo.poolSizeCount = uint32_t(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    poolInfo.maxSets = maxSets;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        throw std::runtime_error("DescriptorManager: failed to create descriptor pool!");
+    return pool;
+}
+
+static VkDescriptorSet allocateSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+        throw std::runtime_error("DescriptorManager: failed to allocate descriptor set!");
+    return set;
+}
+
+void DescriptorManager::create(VkDevice device, bool descriptorIndexing, uint32_t framesInFlight)
+{
+    this->device = device;
+    this->descriptorIndexing = descriptorIndexing;
+
+    // global set
+    VkDescriptorSetLayoutBinding textureBinding{};
+    textureBinding.binding = 0;
+    textureBinding.descriptorCount = MAX_TEXTURES;
+    textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlagsEXT textureFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlags{};
+    bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlags.bindingCount = 1;
+    bindingFlags.pBindingFlags = &textureFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &textureBinding;
+    if (descriptorIndexing) {
+        layoutInfo.pNext = &bindingFlags;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayouts[0]) != VK_SUCCESS)
+        throw std::runtime_error("DescriptorManager: failed to create global set layout!");
+
+    // frame set, dynamic buffers can't live in an update after bind layout so it is a separate set
+    std::array<VkDescriptorSetLayoutBinding, 4> frameBindings{};
+    frameBindings[0].binding = 0;
+    frameBindings[0].descriptorCount = 1;
+    frameBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    frameBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    frameBindings[1].binding = 1;
+    frameBindings[1].descriptorCount = 1;
+    frameBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    frameBindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    frameBindings[2].binding = 2;
+    frameBindings[2].descriptorCount = 1;
+    frameBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    frameBindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    frameBindings[3].binding = 3;
+    frameBindings[3].descriptorCount = 1;
+    frameBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    frameBindings[3].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo frameLayoutInfo{};
+    frameLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    frameLayoutInfo.bindingCount = uint32_t(frameBindings.size());
+    frameLayoutInfo.pBindings = frameBindings.data();
+    if (vkCreateDescriptorSetLayout(device, &frameLayoutInfo, nullptr, &setLayouts[1]) != VK_SUCCESS)
+        throw std::runtime_error("DescriptorManager: failed to create frame set layout!");
+
+    globalPool = createPool(device, { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURES } }, 1,
+                            descriptorIndexing ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0);
+    framePool  = createPool(device, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+                                      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+                                      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 } }, 1, 0);
+    globalSet  = allocateSet(device, globalPool, setLayouts[0]);
+    frameSet   = allocateSet(device, framePool, setLayouts[1]);
+
+    const std::vector<VkDescriptorPoolSize> transientSizes = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 32 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          32 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         32 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         32 },
+    };
+    transientPools.resize(framesInFlight);
+    for (auto& pool : transientPools)
+        pool = createPool(device, transientSizes, 32, 0);
+}
+
+void DescriptorManager::destroy()
+{
+    for (auto pool : transientPools)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    transientPools.clear();
+    vkDestroyDescriptorPool(device, framePool, nullptr);
+    vkDestroyDescriptorPool(device, globalPool, nullptr);
+    for (auto layout : setLayouts)
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    textures.clear();
+}
+
+void DescriptorManager::writeTexture(uint32_t slot, const VkDescriptorImageInfo& texture)
+{
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = globalSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &texture;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+uint32_t DescriptorManager::addTexture(VkImageView view, VkSampler sampler)
+{
+    if (textures.size() == MAX_TEXTURES)
+        throw std::runtime_error("DescriptorManager: out of texture slots, raise MAX_TEXTURES");
+
+    VkDescriptorImageInfo texture{};
+    texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    texture.imageView = view;
+    texture.sampler = sampler;
+
+    uint32_t slot = uint32_t(textures.size());
+    textures.push_back(texture);
+    writeTexture(slot, texture);
+    // without partially bound descriptors every slot must be valid, the first texture fills the rest
+    if (!descriptorIndexing && slot == 0) {
+        for (uint32_t i = 1; i < MAX_TEXTURES; i++)
+            writeTexture(i, texture);
+    }
+    return slot;
+}
+
+void DescriptorManager::setFrameBuffers(VkBuffer uniformBuffer, VkDeviceSize uniformRange, VkBuffer bladePool,
+                                        VkBuffer bladeState, VkDeviceSize bladeStateRange, VkBuffer windField,
+                                        VkDeviceSize windFieldRange)
+{
+    VkDescriptorBufferInfo uniformInfo{};
+    uniformInfo.buffer = uniformBuffer;
+    uniformInfo.offset = 0;
+    uniformInfo.range = uniformRange;
+
+    VkDescriptorBufferInfo bladePoolInfo{};
+    bladePoolInfo.buffer = bladePool;
+    bladePoolInfo.offset = 0;
+    bladePoolInfo.range = VK_WHOLE_SIZE;
+
+    VkDescriptorBufferInfo bladeStateInfo{};
+    bladeStateInfo.buffer = bladeState;
+    bladeStateInfo.offset = 0;
+    bladeStateInfo.range = bladeStateRange;
+
+    VkDescriptorBufferInfo windFieldInfo{};
+    windFieldInfo.buffer = windField;
+    windFieldInfo.offset = 0;
+    windFieldInfo.range = windFieldRange;
+
+    std::array<VkWriteDescriptorSet, 4> writes{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = frameSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writes[0].descriptorCount = 1;
+    writes[0].pBufferInfo = &uniformInfo;
+
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = frameSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].descriptorCount = 1;
+    writes[1].pBufferInfo = &bladePoolInfo;
+
+    writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[2].dstSet = frameSet;
+    writes[2].dstBinding = 2;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    writes[2].descriptorCount = 1;
+    writes[2].pBufferInfo = &bladeStateInfo;
+
+    writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[3].dstSet = frameSet;
+    writes[3].dstBinding = 3;
+    writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    writes[3].descriptorCount = 1;
+    writes[3].pBufferInfo = &windFieldInfo;
+
+    vkUpdateDescriptorSets(device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+}
+
+void DescriptorManager::bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t uniformOffset, uint32_t stateOffset,
+                             uint32_t windOffset) const
+{
+    VkDescriptorSet sets[] = { globalSet, frameSet };
+    // dynamic offsets in binding order
+    uint32_t offsets[] = { uniformOffset, stateOffset, windOffset };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 2, sets, 3, offsets);
+}
+
+void DescriptorManager::beginFrame(uint32_t frame)
+{
+    vkResetDescriptorPool(device, transientPools[frame], 0);
+}
+
+VkDescriptorSet DescriptorManager::allocate(uint32_t frame, VkDescriptorSetLayout layout)
+{
+    return allocateSet(device, transientPools[frame], layout);
+}
@@ -0,0 +1,60 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// size of the texture array of the global set, textures[] in fragment.frag, depth.frag and vertex.vert
+const uint32_t MAX_TEXTURES = 16;
+
+// Descriptor model shared by every graphics pipeline:
+//   set 0 - global: every texture in one combined image sampler array, indexed by a per draw push constant
+//   set 1 - frame:  the uniform buffer, a dynamic offset selects the slice of the frame in flight,
+//                   the blade pool storage buffer, the blade simulation state, a dynamic offset
+//                   selects the half written for the frame, and the wind field, a dynamic offset
+//                   selects the one written for the frame
+// Both sets are written once and bound once per command buffer, so the binding cost does not grow with
+// the number of textures. Sets needed for a single frame come from per frame pools reset wholesale.
+class DescriptorManager
+{
+public:
+    DescriptorManager();
+
+    // with descriptor indexing the texture array is partially bound and can be updated after bind,
+    // otherwise every slot is written and textures must be added before the first frame is recorded
+    void create(VkDevice device, bool descriptorIndexing, uint32_t framesInFlight);
+    void destroy();
+
+    // returns the slot of the texture in the global set
+    uint32_t addTexture(VkImageView view, VkSampler sampler);
+    void     setFrameBuffers(VkBuffer uniformBuffer, VkDeviceSize uniformRange, VkBuffer bladePool,
+                             VkBuffer bladeState, VkDeviceSize bladeStateRange, VkBuffer windField, VkDeviceSize windFieldRange);
+    void     bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t uniformOffset, uint32_t stateOffset,
+                  uint32_t windOffset) const;
+
+    // frees every set allocated for the frame, call once the frame's fence has signalled
+    void            beginFrame(uint32_t frame);
+    VkDescriptorSet allocate(uint32_t frame, VkDescriptorSetLayout layout);
+
+    const std::array<VkDescriptorSetLayout, 2>& layouts() const { return setLayouts; }
+    uint32_t textureCount() const { return uint32_t(textures.size()); }
+
+private:
+    VkDevice                             device;
+    bool                                 descriptorIndexing;
+    std::array<VkDescriptorSetLayout, 2> setLayouts;
+    VkDescriptorPool                     globalPool;
+    VkDescriptorPool                     framePool;
+    VkDescriptorSet                      globalSet;
+    VkDescriptorSet                      frameSet;
+    std::vector<VkDescriptorPool>        transientPools;
+    std::vector<VkDescriptorImageInfo>   textures;
+
+    void writeTexture(uint32_t slot, const VkDescriptorImageInfo& texture);
+};
+
+#endif //DESCRIPTORS_H
@@ -0,0 +1,35 @@
+#include "DrawList.h"
+
+#include <cstddef>
+#include <cstring>
+
+void DrawList::add(VkPipeline pipeline, const MeshRange& range, const DrawParams& params, 
+                   uint32_t instanceCount, uint32_t firstInstance)
+{
+    if (instanceCount == 0 || range.indexCount == 0)
+        return;
+    items.push_back({ pipeline, range, params, instanceCount, firstInstance });
+}
+
+uint32_t DrawList::record(VkCommandBuffer commandBuffer, VkPipelineLayout layout) const
+{
+    uint32_t binds = 0;
+    VkPipeline bound = VK_NULL_HANDLE;
+    const DrawParams* pushed = nullptr;
+    for (const DrawItem& item : items) {
+        if (item.pipeline != bound) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+            bound = item.pipeline;
+            binds++;
+        }
+        // all pipelines share the layout, so pushed values survive pipeline binds
+        if (pushed == nullptr || memcmp(pushed, &item.params, sizeof(DrawParams)) != 0) {
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(PushConstants, draw), 
+                               sizeof(DrawParams), &item.params);
+            pushed = &item.params;
+        }
+        vkCmdDrawIndexed(commandBuffer, item.range.indexCount, item.instanceCount, item.range.firstIndex, 
+                         item.range.vertexOffset, item.firstInstance);
+    }
+    return binds;
+}
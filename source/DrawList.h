@@ -0,0 +1,59 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Mesh.h"
+
+// per-draw part of the push constants
+struct DrawParams
+{
+    glm::vec2 origin;  // world xz offset of the renderable
+    uint32_t  lod;
+    uint32_t  textureSlot; // slot in the texture array of the global descriptor set
+};
+
+// push constant block of ground.vert and vertex.vert, 88 of the guaranteed 128 bytes
+struct PushConstants
+{
+    glm::mat4  viewProj;
+    float      time;
+    float      pad;
+    DrawParams draw;
+};
+static_assert(sizeof(PushConstants) == 88, "PushConstants must match the push_constant block of the vertex shaders");
+
+struct DrawItem
+{
+    VkPipeline pipeline;
+    MeshRange  range;
+    DrawParams params;
+    uint32_t   instanceCount;
+    uint32_t   firstInstance;
+};
+
+// Renderables of one frame. Items are recorded in the order they were added and the
+// pipeline is only rebound when it changes, so callers add items grouped by pipeline.
+// Vertex/index buffers, descriptor sets and the per frame push constants are shared by all
+// items and set by the caller, the per draw parameters are pushed when they change.
+class DrawList
+{
+public:
+    void clear() { items.clear(); }
+    void add(VkPipeline pipeline, const MeshRange& range, const DrawParams& params, 
+             uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+    // returns the number of pipeline binds
+    uint32_t record(VkCommandBuffer commandBuffer, VkPipelineLayout layout) const;
+
+    size_t size() const { return items.size(); }
+
+private:
+    std::vector<DrawItem> items;
+};
+
+#endif //DRAW_LIST_H
@@ -0,0 +1,184 @@
+#include "FrameCapture.h"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+static bool endsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+FrameCapture::FrameCapture(const std::string& path, uint32_t width, uint32_t height, uint32_t fps, bool bgr,
+                           const std::vector<const uint8_t*>& slots) :
+    path(path), width(width), height(height), bgr(bgr), video(endsWith(path, ".y4m")), slots(slots),
+    states(slots.size(), SlotState::Free), stopping(false), failed(false), counters(), encodeSeconds(0.0)
+{
+    if (video) {
+        stream.open(path, std::ios::binary);
+        if (!stream.is_open())
+            throw std::runtime_error("FrameCapture: can't create " + path);
+        // progressive, square pixels, chroma sited between the luma samples like the 2x2 average
+        stream << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+    } else {
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        if (!std::filesystem::is_directory(path))
+            throw std::runtime_error("FrameCapture: can't create directory " + path);
+    }
+    thread = std::thread(&FrameCapture::encodeLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+int32_t FrameCapture::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (counters.offered++ == 0)
+        start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < states.size(); i++) {
+        if (states[i] == SlotState::Free) {
+            states[i] = SlotState::Copying;
+            return int32_t(i);
+        }
+    }
+    counters.dropped++;
+    return -1;
+}
+
+void FrameCapture::queue(uint32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[slot] = SlotState::Queued;
+        pending.push_back(slot);
+    }
+    wake.notify_one();
+}
+
+CaptureStats FrameCapture::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    CaptureStats result = counters;
+    result.queued   = pending.size();
+    result.seconds  = counters.offered > 0 ? std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() : 0.0;
+    result.encodeMs = counters.written > 0 ? encodeSeconds * 1000.0 / counters.written : 0.0;
+    return result;
+}
+
+void FrameCapture::report(std::ostream& out)
+{
+    CaptureStats current = stats();
+    out << "Capture: " << current.written << " of " << current.offered << " frames written to " << path << ", "
+        << current.dropped << " dropped, " << current.queued << " queued, " << current.framesPerSecond()
+        << " frames/s sustained, " << current.encodeMs << " ms/frame encoding" << std::endl;
+}
+
+void FrameCapture::encodeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty())
+            return;
+        uint32_t slot = pending.front();
+        pending.pop_front();
+        uint64_t frame = counters.written;
+        lock.unlock();
+
+        // only this thread reads a queued slot, the render thread waits for it to be free again
+        auto begin = std::chrono::steady_clock::now();
+        bool written = !failed && write(slots[slot], frame);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        lock.lock();
+        states[slot] = SlotState::Free;
+        if (written) {
+            counters.written++;
+            encodeSeconds += seconds;
+        } else {
+            counters.dropped++;
+        }
+    }
+}
+
+bool FrameCapture::write(const uint8_t* pixels, uint64_t frame)
+{
+    if (video) {
+        convertYuv420(pixels);
+        stream << "FRAME\n";
+        stream.write(reinterpret_cast<const char*>(converted.data()), std::streamsize(converted.size()));
+        if (!stream)
+            std::cerr << "Capture: failed to write " << path << ", capturing stopped" << std::endl;
+        failed = !stream;
+        return !failed;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%06llu.ppm", static_cast<unsigned long long>(frame));
+    std::string framePath = (std::filesystem::path(path) / name).string();
+    convertRgb(pixels);
+    std::ofstream file(framePath, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(converted.data()), std::streamsize(converted.size()));
+    if (!file)
+        std::cerr << "Capture: failed to write " << framePath << ", capturing stopped" << std::endl;
+    failed = !file;
+    return !failed;
+}
+
+// BT.601 studio range, what players assume for a y4m without a color range tag
+void FrameCapture::convertYuv420(const uint8_t* pixels)
+{
+    const uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    const size_t lumaSize = size_t(width) * height, chromaSize = size_t(chromaWidth) * chromaHeight;
+    converted.resize(lumaSize + 2 * chromaSize);
+    uint8_t* luma = converted.data();
+    uint8_t* cb   = luma + lumaSize;
+    uint8_t* cr   = cb + chromaSize;
+    const int r = bgr ? 2 : 0, b = bgr ? 0 : 2;
+
+    for (size_t i = 0; i < lumaSize; i++) {
+        const uint8_t* p = pixels + 4 * i;
+        luma[i] = uint8_t(((66 * p[r] + 129 * p[1] + 25 * p[b] + 128) >> 8) + 16);
+    }
+    // each chroma sample averages a 2x2 block, the last row and column repeat on odd sizes
+    for (uint32_t y = 0; y < chromaHeight; y++) {
+        for (uint32_t x = 0; x < chromaWidth; x++) {
+            int sum[3] = { 0, 0, 0 };
+            for (uint32_t dy = 0; dy < 2; dy++) {
+                for (uint32_t dx = 0; dx < 2; dx++) {
+                    uint32_t sx = std::min(2 * x + dx, width - 1), sy = std::min(2 * y + dy, height - 1);
+                    const uint8_t* p = pixels + 4 * (size_t(sy) * width + sx);
+                    sum[0] += p[r];
+                    sum[1] += p[1];
+                    sum[2] += p[b];
+                }
+            }
+            int red = sum[0] / 4, green = sum[1] / 4, blue = sum[2] / 4;
+            cb[size_t(y) * chromaWidth + x] = uint8_t(((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128);
+            cr[size_t(y) * chromaWidth + x] = uint8_t(((112 * red - 94 * green - 18 * blue + 128) >> 8) + 128);
+        }
+    }
+}
+
+void FrameCapture::convertRgb(const uint8_t* pixels)
+{
+    const int r = bgr ? 2 : 0, b = bgr ? 0 : 2;
+    converted.resize(size_t(width) * height * 3);
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+        converted[3 * i + 0] = pixels[4 * i + r];
+        converted[3 * i + 1] = pixels[4 * i + 1];
+        converted[3 * i + 2] = pixels[4 * i + b];
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+#include <ostream>
+
+struct CaptureStats
+{
+    uint64_t offered;  // frames rendered while capturing
+    uint64_t written;
+    uint64_t dropped;  // every slot was still being copied or encoded
+    uint64_t queued;   // waiting for the encoder
+    double   seconds;  // since the first frame was offered
+    double   encodeMs; // per written frame, on the encoder thread
+
+    double framesPerSecond() const { return seconds > 0.0 ? written / seconds : 0.0; }
+};
+
+// Writes rendered frames on its own thread. The caller owns a ring of slots (mapped read back
+// buffers of width * height * 4 bytes), copies a frame into a slot it acquired and queues the slot
+// once the copy has completed. A frame that finds no free slot is dropped instead of waiting, so
+// the render loop never blocks on the disk. "<name>.y4m" is written as one 4:2:0 video stream,
+// any other path is a directory that receives a frame_<n>.ppm per frame.
+class FrameCapture
+{
+public:
+    // bgr: the slots hold B8G8R8A8 pixels, R8G8B8A8 otherwise.
+    // throws std::runtime_error when the output can't be created
+    FrameCapture(const std::string& path, uint32_t width, uint32_t height, uint32_t fps, bool bgr,
+                 const std::vector<const uint8_t*>& slots);
+    // writes every queued frame
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // a free slot for the next frame, -1 when the frame has to be dropped
+    int32_t acquire();
+    // the copy into slot has completed, slots are written in the order they are queued
+    void queue(uint32_t slot);
+    CaptureStats stats();
+    void report(std::ostream& out);
+
+private:
+    enum class SlotState { Free, Copying, Queued };
+
+    const std::string                  path;
+    const uint32_t                     width;
+    const uint32_t                     height;
+    const bool                         bgr;
+    const bool                         video;
+    std::vector<const uint8_t*>        slots;
+    std::vector<SlotState>             states;
+    std::ofstream                      stream;
+    std::vector<uint8_t>               converted;
+
+    std::thread                        thread;
+    std::mutex                         mutex;
+    std::condition_variable            wake;
+    std::deque<uint32_t>               pending;
+    bool                               stopping;
+    bool                               failed;
+    CaptureStats                       counters;
+    double                             encodeSeconds;
+    std::chrono::steady_clock::time_point start;
+
+    void encodeLoop();
+    bool write(const uint8_t* pixels, uint64_t frame);
+    void convertYuv420(const uint8_t* pixels);
+    void convertRgb(const uint8_t* pixels);
+};
+
+#endif //FRAME_CAPTURE_H
@@ -0,0 +1,225 @@
+#include "GrassField.h"
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <iomanip>
+
+uint64_t chunkKey(const ChunkCoord& coord)
+{
+    return (uint64_t(uint32_t(coord.x)) << 32) | uint64_t(uint32_t(coord.z));
+}
+
+uint32_t packVariation(uint32_t species, float phase)
+{
+    uint32_t quantized = std::min(uint32_t(phase / PHASE_RANGE * 16777216.0f), 16777215u);
+    return (quantized << 8) | (species & 0xff);
+}
+
+// splitmix64 folded to 32 bits, every bit of the key reaches the seed
+static uint32_t chunkSeed(const ChunkCoord& coord)
+{
+    uint64_t z = chunkKey(coord) + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return uint32_t(z ^ (z >> 32));
+}
+
+void generateChunk(const ChunkCoord& coord, uint32_t speciesCount, uint32_t bladesPerSide, std::vector<BladeInstance>& blades)
+{
+    // seeded by the chunk position so a chunk looks the same every time it is streamed in
+    std::mt19937 rng(chunkSeed(coord));
+    std::uniform_real_distribution<float> jitter(-0.35f, 0.35f);
+    std::uniform_real_distribution<float> scale(0.8f, 1.2f);
+    std::uniform_real_distribution<float> phase(0.0f, PHASE_RANGE);
+    std::uniform_int_distribution<uint32_t> species(0, speciesCount - 1);
+    std::uniform_real_distribution<float> mix(0.0f, 1.0f);
+
+    // species grow in patches: most blades of a chunk share its dominant species
+    uint32_t dominant = species(rng);
+
+    const float step = CHUNK_SIZE / bladesPerSide;
+    blades.resize(bladesPerSide * bladesPerSide);
+    for (uint32_t j = 0; j < bladesPerSide; j++) {
+        for (uint32_t i = 0; i < bladesPerSide; i++) {
+            BladeInstance& blade = blades[j * bladesPerSide + i];
+            blade.x     = coord.x * CHUNK_SIZE + (i + 0.5f + jitter(rng)) * step;
+            blade.z     = coord.z * CHUNK_SIZE + (j + 0.5f + jitter(rng)) * step;
+            blade.scale = scale(rng);
+            blade.variation = packVariation(mix(rng) < 0.75f ? dominant : species(rng), phase(rng));
+        }
+    }
+}
+
+GrassField::GrassField(JobSystem& jobs, int32_t radius, uint32_t speciesCount, uint32_t framesInFlight, uint32_t bladesPerSide,
+                       float bladeHeight) :
+    radius(radius), speciesCount(std::max(1u, speciesCount)), framesInFlight(framesInFlight),
+    bladesPerSide(std::max(1u, bladesPerSide)), bladeHeight(bladeHeight), fieldCenter(0.0f, 0.0f), jobs(jobs), 
+    generating(0), stopping(false), uploadedBytes(0), uploadedChunks(0), evictions(0)
+{
+    // the resident set is bounded: every chunk in the radius plus one ring of slack for LRU reuse
+    uint32_t side = uint32_t(2 * radius + 1);
+    slots.resize(side * side + 2 * side);
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        slots[i].used = false;
+        freeSlots.push_back(uint32_t(slots.size()) - 1 - i);
+    }
+    centers.resize(bladeCapacity());
+}
+
+GrassField::~GrassField()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    // the jobs still queued return without generating
+    jobs.wait(generation);
+}
+
+void GrassField::generateNext()
+{
+    ChunkResult result;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        // requests dropped by update leave jobs with nothing to do
+        if (stopping || requests.empty())
+            return;
+        result.coord = requests.front();
+        requests.pop_front();
+        generating++;
+    }
+
+    generateChunk(result.coord, speciesCount, bladesPerSide, result.blades);
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    finished.push_back(std::move(result));
+    generating--;
+}
+
+bool GrassField::inRadius(const ChunkCoord& coord, const ChunkCoord& origin, int32_t r) const
+{
+    return std::abs(coord.x - origin.x) <= r && std::abs(coord.z - origin.z) <= r;
+}
+
+uint32_t GrassField::acquireSlot(uint64_t frame)
+{
+    if (!freeSlots.empty()) {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    // evict the least recently used chunk that is no longer inside the radius and no longer read by
+    // a frame in flight, uploads may come from another queue that does not wait for those frames
+    uint32_t victim = UINT32_MAX;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].used && slots[i].lastUsed + std::max(framesInFlight, 1u) <= frame &&
+            (victim == UINT32_MAX || slots[i].lastUsed < slots[victim].lastUsed))
+            victim = i;
+    }
+    if (victim != UINT32_MAX) {
+        resident.erase(chunkKey(slots[victim].coord));
+        slots[victim].used = false;
+        evictions++;
+    }
+    return victim;
+}
+
+void GrassField::update(const glm::vec2& camera, uint64_t frame, uint32_t maxUploads, std::vector<ChunkUpload>& uploads)
+{
+    ChunkCoord origin = { int32_t(std::floor(camera.x / CHUNK_SIZE)), int32_t(std::floor(camera.y / CHUNK_SIZE)) };
+    fieldCenter = glm::vec2((origin.x + 0.5f) * CHUNK_SIZE, (origin.z + 0.5f) * CHUNK_SIZE);
+
+    std::vector<ChunkCoord> missing;
+    for (int32_t dz = -radius; dz <= radius; dz++) {
+        for (int32_t dx = -radius; dx <= radius; dx++) {
+            ChunkCoord coord = { origin.x + dx, origin.z + dz };
+            uint64_t key = chunkKey(coord);
+            auto it = resident.find(key);
+            if (it != resident.end()) {
+                slots[it->second].lastUsed = frame;
+            } else if (pending.insert(key).second) {
+                missing.push_back(coord);
+            }
+        }
+    }
+    std::sort(missing.begin(), missing.end(), [&origin](const ChunkCoord& a, const ChunkCoord& b) {
+        return std::abs(a.x - origin.x) + std::abs(a.z - origin.z) < std::abs(b.x - origin.x) + std::abs(b.z - origin.z);
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        // forget requests the camera has already moved away from
+        for (auto it = requests.begin(); it != requests.end();) {
+            if (!inRadius(*it, origin, radius + 1)) {
+                pending.erase(chunkKey(*it));
+                it = requests.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        requests.insert(requests.end(), missing.begin(), missing.end());
+        for (auto& result : finished)
+            waiting.push_back(std::move(result));
+        finished.clear();
+    }
+    for (size_t i = 0; i < missing.size(); i++)
+        jobs.run([this]() { generateNext(); }, &generation);
+
+    // a bounded number of uploads per frame keeps streaming from causing hitches
+    while (!waiting.empty() && uploads.size() < maxUploads) {
+        uint64_t key = chunkKey(waiting.front().coord);
+        if (!inRadius(waiting.front().coord, origin, radius)) {
+            pending.erase(key);
+            waiting.pop_front();
+            continue;
+        }
+
+        uint32_t slot = acquireSlot(frame);
+        if (slot == UINT32_MAX)
+            break;
+
+        ChunkResult result = std::move(waiting.front());
+        waiting.pop_front();
+        pending.erase(key);
+
+        slots[slot] = { result.coord, true, frame };
+        resident[key] = slot;
+        // the blade mesh spans the unit square before scaling, the center is its middle
+        for (uint32_t i = 0; i < bladesPerChunk(); i++) {
+            const BladeInstance& blade = result.blades[i];
+            float half = 0.5f * bladeHeight * blade.scale;
+            centers[slot * bladesPerChunk() + i] = glm::vec3(blade.x + half, half, blade.z);
+        }
+        uploadedBytes += result.blades.size() * sizeof(BladeInstance);
+        uploadedChunks++;
+        uploads.push_back({ slot, std::move(result.blades) });
+    }
+
+    visible.clear();
+    for (uint32_t slot = 0; slot < slots.size(); slot++) {
+        if (!slots[slot].used || slots[slot].lastUsed != frame)
+            continue;
+        for (uint32_t i = 0; i < bladesPerChunk(); i++)
+            visible.push_back(slot * bladesPerChunk() + i);
+    }
+}
+
+void GrassField::report(std::ostream& out, float seconds)
+{
+    size_t queueDepth;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queueDepth = requests.size();
+    }
+    out << "Field: " << resident.size() << "/" << slots.size() << " chunks resident, "
+        << "queue depth " << queueDepth << ", generating " << generating.load() << ", ready " << waiting.size() << ", "
+        << uploadedChunks << " uploads (" << std::fixed << std::setprecision(3)
+        << uploadedBytes / seconds / (1024.0 * 1024.0) << " MB/s), " << evictions << " evictions" << std::endl;
+    out.unsetf(std::ios::fixed);
+    uploadedBytes  = 0;
+    uploadedChunks = 0;
+    evictions      = 0;
+}
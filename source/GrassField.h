@@ -0,0 +1,122 @@
+#ifndef GRASS_FIELD_H
+#define GRASS_FIELD_H
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+const float    CHUNK_SIZE       = 4.0f;
+const float    PHASE_RANGE      = 500.0f;
+
+// per-blade attributes, read by vertex.vert from the blade pool storage buffer
+struct BladeInstance
+{
+    float    x;
+    float    z;
+    float    scale;
+    uint32_t variation; // species (texture array layer) in the low 8 bits, wind phase in the upper 24
+};
+
+struct ChunkCoord
+{
+    int32_t x;
+    int32_t z;
+};
+
+struct ChunkUpload
+{
+    uint32_t                   slot;
+    std::vector<BladeInstance> blades;
+};
+
+// Camera-centred tiled grass field. Chunks are generated as jobs, handed out as
+// uploads into a fixed pool of slots and evicted least-recently-used when the pool is full.
+class GrassField
+{
+public:
+    // a slot drawn in frame N is not reused before frame N + framesInFlight, when the GPU is done with it
+    // a chunk is a grid of bladesPerSide x bladesPerSide blades; bladeHeight is the world height of a
+    // blade at instance scale 1 (SceneConstants::bladeScale), it places the lod centers
+    GrassField(JobSystem& jobs, int32_t radius, uint32_t speciesCount, uint32_t framesInFlight, uint32_t bladesPerSide,
+               float bladeHeight);
+    ~GrassField();
+
+    // queues generation for chunks around the camera and returns at most maxUploads finished chunks
+    void update(const glm::vec2& camera, uint64_t frame, uint32_t maxUploads, std::vector<ChunkUpload>& uploads);
+    void report(std::ostream& out, float seconds);
+
+    uint32_t                      slotCount() const       { return uint32_t(slots.size()); }
+    uint32_t                      bladesPerChunk() const  { return bladesPerSide * bladesPerSide; }
+    uint32_t                      bladeCapacity() const   { return slotCount() * bladesPerChunk(); }
+    glm::vec2                     center() const        { return fieldCenter; }
+    float                         halfExtent() const    { return (radius + 0.5f) * CHUNK_SIZE; }
+    // pool-wide blade ids of the chunks inside the radius, and centers indexed by blade id
+    const std::vector<uint32_t>&  visibleBlades() const { return visible; }
+    const std::vector<glm::vec3>& bladeCenters() const  { return centers; }
+    // every chunk inside the radius is resident, nothing is generating or waiting for a slot
+    bool                          complete() const      { return pending.empty() && waiting.empty(); }
+
+private:
+    struct Slot
+    {
+        ChunkCoord coord;
+        bool       used;
+        uint64_t   lastUsed;
+    };
+
+    struct ChunkResult
+    {
+        ChunkCoord                 coord;
+        std::vector<BladeInstance> blades;
+    };
+
+    int32_t                           radius;
+    uint32_t                          speciesCount;
+    uint32_t                          framesInFlight;
+    uint32_t                          bladesPerSide;
+    float                             bladeHeight;
+    glm::vec2                         fieldCenter;
+    std::vector<Slot>                 slots;
+    std::vector<uint32_t>             freeSlots;
+    std::unordered_map<uint64_t, uint32_t> resident;
+    std::unordered_set<uint64_t>      pending;
+    std::deque<ChunkResult>           waiting;
+    std::vector<uint32_t>             visible;
+    std::vector<glm::vec3>            centers;
+
+    JobSystem&                        jobs;
+    // one job per request, each takes the nearest request still wanted when it runs
+    JobCounter                        generation;
+    std::mutex                        queueMutex;
+    std::deque<ChunkCoord>            requests;
+    std::vector<ChunkResult>          finished;
+    std::atomic<uint32_t>             generating;
+    bool                              stopping;
+
+    uint64_t                          uploadedBytes;
+    uint32_t                          uploadedChunks;
+    uint32_t                          evictions;
+
+    void     generateNext();
+    bool     inRadius(const ChunkCoord& coord, const ChunkCoord& origin, int32_t r) const;
+    uint32_t acquireSlot(uint64_t frame);
+};
+
+uint64_t chunkKey(const ChunkCoord& coord);
+void generateChunk(const ChunkCoord& coord, uint32_t speciesCount, uint32_t bladesPerSide, std::vector<BladeInstance>& blades);
+// phase in [0, PHASE_RANGE), quantized to 24 bits
+uint32_t packVariation(uint32_t species, float phase);
+
+#endif //GRASS_FIELD_H
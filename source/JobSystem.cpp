@@ -0,0 +1,241 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+// the worker the current thread is, in the system it belongs to
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local uint32_t         currentIndex  = 0;
+// failed searches before an idle worker goes to sleep
+const uint32_t IDLE_SPINS = 64;
+
+JobSystem::Deque::Deque() : top(0), bottom(0), ring(new std::atomic<Job*>[CAPACITY])
+{
+}
+
+bool JobSystem::Deque::push(Job* job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    if (b - top.load(std::memory_order_acquire) >= CAPACITY)
+        return false;
+    ring[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = ring[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // last job, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    Job* job = ring[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+uint32_t JobSystem::defaultWorkers()
+{
+    uint32_t threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+}
+
+JobSystem::JobSystem(uint32_t extraWorkers) : stopping(false), queued(0), sleeping(0), steals(0)
+{
+    for (uint32_t i = 0; i <= extraWorkers; i++)
+        deques.emplace_back(new Deque());
+
+    outerSystem   = currentSystem;
+    outerIndex    = currentIndex;
+    currentSystem = this;
+    currentIndex  = 0;
+    for (uint32_t i = 1; i <= extraWorkers; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    if (currentSystem == this) {
+        currentSystem = outerSystem;
+        currentIndex  = outerIndex;
+    }
+}
+
+uint32_t JobSystem::currentWorker() const
+{
+    if (currentSystem != this)
+        throw std::runtime_error("JobSystem: jobs can only be started from a worker thread!");
+    return currentIndex;
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter* counter)
+{
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    Job* job = new Job{ std::move(function), counter };
+
+    // a full deque means the workers are far behind, running the job here is the back pressure
+    if (workers.empty() || !deques[currentWorker()]->push(job)) {
+        execute(job);
+        return;
+    }
+
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+JobSystem::Job* JobSystem::findJob(uint32_t index)
+{
+    Job* job = deques[index]->pop();
+    if (!job) {
+        // start at a different victim every time so the thieves spread over the deques
+        static thread_local uint32_t seed = index * 2654435761u + 1;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        uint32_t count = uint32_t(deques.size());
+        for (uint32_t i = 0; i < count && !job; i++) {
+            uint32_t victim = (seed + i) % count;
+            if (victim != index)
+                job = deques[victim]->steal();
+        }
+        if (job)
+            steals.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (job)
+        queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->function();
+    if (job->counter)
+        job->counter->pending.fetch_sub(1, std::memory_order_release);
+    delete job;
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+    currentSystem = this;
+    currentIndex  = index;
+
+    uint32_t idle = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (Job* job = findJob(index)) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // run() checks for sleepers after publishing the job, so one of the two sides sees the other
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this] { return stopping.load() || queued.load(std::memory_order_seq_cst) > 0; });
+        }
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    uint32_t index = currentWorker();
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (Job* job = findJob(index))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body)
+{
+    grain = std::max(grain, 1u);
+    if (count <= grain || workers.empty()) {
+        if (count > 0)
+            body(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t begin = grain; begin < count; begin += grain) {
+        uint32_t end = std::min(begin + grain, count);
+        run([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    body(0, grain);
+    wait(counter);
+}
+
+void benchmarkJobScaling(std::ostream& out, uint32_t items, uint32_t grain,
+                         const std::function<void(uint32_t, uint32_t)>& work)
+{
+    const uint32_t repeats = 5;
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double baseline = 0.0;
+
+    out << "Jobs: " << items << " items in ranges of " << grain << ", best of " << repeats << " runs" << std::endl;
+    for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads - 1);
+        // untimed run to start the workers and warm the caches
+        jobs.parallelFor(items, grain, work);
+
+        double best = 0.0;
+        for (uint32_t i = 0; i < repeats; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            jobs.parallelFor(items, grain, work);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = i == 0 ? ms : std::min(best, ms);
+        }
+        if (threads == 1)
+            baseline = best;
+
+        double speedup = best > 0.0 ? baseline / best : 0.0;
+        out << "Jobs: " << std::setw(2) << threads << " threads " << std::fixed << std::setprecision(2)
+            << std::setw(8) << best << " ms, speedup " << speedup << "x, efficiency "
+            << std::setprecision(0) << 100.0 * speedup / threads << "%, " << jobs.stolenJobs() << " steals" << std::endl;
+        out.unsetf(std::ios::fixed);
+        out << std::setprecision(6);
+    }
+}
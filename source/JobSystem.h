@@ -0,0 +1,94 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <ostream>
+
+// Jobs started with a counter increment it and decrement it when they finish. A job may start
+// children on the counter it was started with, waiting on the counter then joins the whole tree.
+struct JobCounter
+{
+    std::atomic<uint32_t> pending{0};
+};
+
+// Fixed pool of workers, each with its own work-stealing deque. The thread that creates the
+// system is worker 0: it pushes to its own deque and runs jobs while it waits on a counter.
+// Jobs can only be started from the workers, the jobs themselves included.
+class JobSystem
+{
+public:
+    // 0 workers besides the calling thread runs everything inline
+    explicit JobSystem(uint32_t extraWorkers = defaultWorkers());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void run(std::function<void()> function, JobCounter* counter = nullptr);
+    // runs other jobs until the counter drops to zero
+    void wait(JobCounter& counter);
+    // body(begin, end) over [0, count) in ranges of grain items, the caller runs the first range
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body);
+
+    uint32_t threadCount() const { return uint32_t(deques.size()); }
+    // jobs that ran on a different worker than the one that started them
+    uint64_t stolenJobs() const  { return steals.load(std::memory_order_relaxed); }
+
+    static uint32_t defaultWorkers();
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter*           counter;
+    };
+
+    // Chase-Lev deque: the owner pushes and pops at the bottom, thieves take from the top
+    class Deque
+    {
+    public:
+        Deque();
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        static const int64_t CAPACITY = 4096;
+        std::atomic<int64_t> top;
+        std::atomic<int64_t> bottom;
+        std::unique_ptr<std::atomic<Job*>[]> ring;
+    };
+
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::vector<std::thread>            workers;
+    std::atomic<bool>                   stopping;
+    // jobs pushed and not taken yet, idle workers sleep while it is zero
+    std::atomic<uint32_t>               queued;
+    std::atomic<uint32_t>               sleeping;
+    std::mutex                          sleepMutex;
+    std::condition_variable             wakeUp;
+    std::atomic<uint64_t>               steals;
+    // the system the creating thread belonged to before, restored on destruction
+    const JobSystem*                    outerSystem;
+    uint32_t                            outerIndex;
+
+    void workerLoop(uint32_t index);
+    Job* findJob(uint32_t index);
+    void execute(Job* job);
+    uint32_t currentWorker() const;
+};
+
+// times work over [0, items) in ranges of grain with 1 to hardware_concurrency threads
+void benchmarkJobScaling(std::ostream& out, uint32_t items, uint32_t grain,
+                         const std::function<void(uint32_t, uint32_t)>& work);
+
+#endif //JOB_SYSTEM_H
@@ -0,0 +1,166 @@
+#include "MemoryTracker.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// without VK_EXT_memory_budget, the share of a heap we allow ourselves
+const float FALLBACK_BUDGET_FRACTION = 0.8f;
+// warnings stop once usage drops this far below the threshold again
+const float WARN_HYSTERESIS = 0.05f;
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::Vertex:     return "vertex";
+    case MemoryCategory::Index:      return "index";
+    case MemoryCategory::Uniform:    return "uniform";
+    case MemoryCategory::Texture:    return "texture";
+    case MemoryCategory::Staging:    return "staging";
+    case MemoryCategory::Attachment: return "attachment";
+    case MemoryCategory::Storage:    return "storage";
+    default:                         return "unknown";
+    }
+}
+
+static std::string mib(VkDeviceSize bytes)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << double(bytes) / (1024.0 * 1024.0);
+    return text.str();
+}
+
+MemoryTracker::MemoryTracker() :
+    physicalDevice(VK_NULL_HANDLE), getProperties2(nullptr), budgetExtension(false), warnFraction(0.9f), properties{}
+{
+    heapAllocated.fill(0);
+    typeAllocated.fill(0);
+    categoryAllocated.fill(0);
+    queriedUsage.fill(0);
+    queriedAllocated.fill(0);
+    budget.fill(0);
+    overBudget.fill(false);
+}
+
+void MemoryTracker::init(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getProperties2,
+                         bool budgetExtension)
+{
+    this->physicalDevice = physicalDevice;
+    this->getProperties2 = getProperties2;
+    this->budgetExtension = budgetExtension && getProperties2 != nullptr;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+    updateBudget();
+}
+
+uint32_t MemoryTracker::findType(uint32_t typeBits, VkMemoryPropertyFlags flags) const
+{
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags)
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+VkDeviceSize MemoryTracker::heapUsage(uint32_t heap) const
+{
+    if (!budgetExtension)
+        return heapAllocated[heap];
+    // the driver was last asked at updateBudget, add what we allocated or freed since
+    return queriedUsage[heap] + heapAllocated[heap] - queriedAllocated[heap];
+}
+
+void MemoryTracker::record(VkDeviceMemory memory, VkDeviceSize size, uint32_t typeIndex, MemoryCategory category)
+{
+    allocations[memory] = { size, typeIndex, category };
+    uint32_t heap = properties.memoryTypes[typeIndex].heapIndex;
+    heapAllocated[heap] += size;
+    typeAllocated[typeIndex] += size;
+    categoryAllocated[uint32_t(category)] += size;
+    checkHeap(heap);
+}
+
+void MemoryTracker::release(VkDeviceMemory memory)
+{
+    auto it = allocations.find(memory);
+    if (it == allocations.end())
+        return;
+    const Allocation& allocation = it->second;
+    heapAllocated[properties.memoryTypes[allocation.typeIndex].heapIndex] -= allocation.size;
+    typeAllocated[allocation.typeIndex] -= allocation.size;
+    categoryAllocated[uint32_t(allocation.category)] -= allocation.size;
+    allocations.erase(it);
+}
+
+void MemoryTracker::updateBudget()
+{
+    if (budgetExtension) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        getProperties2(physicalDevice, &properties2);
+        for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+            budget[heap] = budgetProperties.heapBudget[heap];
+            queriedUsage[heap] = budgetProperties.heapUsage[heap];
+            queriedAllocated[heap] = heapAllocated[heap];
+        }
+    }
+    else {
+        for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++)
+            budget[heap] = VkDeviceSize(properties.memoryHeaps[heap].size * FALLBACK_BUDGET_FRACTION);
+    }
+
+    for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++)
+        checkHeap(heap);
+}
+
+uint32_t MemoryTracker::heapOf(VkDeviceMemory memory) const
+{
+    auto it = allocations.find(memory);
+    return it == allocations.end() ? UINT32_MAX : properties.memoryTypes[it->second.typeIndex].heapIndex;
+}
+
+void MemoryTracker::checkHeap(uint32_t heap)
+{
+    if (budget[heap] == 0)
+        return;
+
+    VkDeviceSize usage = heapUsage(heap);
+    double fraction = double(usage) / double(budget[heap]);
+    if (fraction < warnFraction) {
+        if (fraction < warnFraction - WARN_HYSTERESIS)
+            overBudget[heap] = false;
+        return;
+    }
+
+    if (!overBudget[heap]) {
+        std::cerr << "Memory: heap " << heap << " at " << mib(usage) << " of " << mib(budget[heap]) 
+                  << " MiB budget" << std::endl;
+        overBudget[heap] = true;
+    }
+}
+
+void MemoryTracker::report(std::ostream& out) const
+{
+    for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+        if (heapAllocated[heap] == 0 && !budgetExtension)
+            continue;
+        bool deviceLocal = (properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        out << "Memory heap " << heap << (deviceLocal ? " (device): " : " (host):   ")
+            << std::setw(7) << mib(heapAllocated[heap]) << " MiB allocated, "
+            << std::setw(7) << mib(heapUsage(heap)) << " of " << mib(budget[heap]) << " MiB budget"
+            << (budgetExtension ? "" : " (estimated)") << std::endl;
+        for (uint32_t type = 0; type < properties.memoryTypeCount; type++) {
+            if (properties.memoryTypes[type].heapIndex == heap && typeAllocated[type] > 0)
+                out << "  type " << type << ": " << std::setw(7) << mib(typeAllocated[type]) << " MiB" << std::endl;
+        }
+    }
+    out << "Memory categories:";
+    for (uint32_t category = 0; category < uint32_t(MemoryCategory::Count); category++) {
+        if (categoryAllocated[category] > 0)
+            out << " " << memoryCategoryName(MemoryCategory(category)) << " " << mib(categoryAllocated[category]) << " MiB";
+    }
+    out << ", " << allocations.size() << " allocations" << std::endl;
+}
@@ -0,0 +1,84 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <ostream>
+
+enum class MemoryCategory : uint32_t
+{
+    Vertex,
+    Index,
+    Uniform,
+    Texture,
+    Staging,
+    Attachment,
+    Storage,
+    Count
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+// Accounting of every VkDeviceMemory the app allocates, per heap, per memory type and per category.
+// With VK_EXT_memory_budget the driver's view of each heap (other processes included) is queried,
+// otherwise the budget is a fixed fraction of the heap size and the usage is what was tracked here.
+class MemoryTracker
+{
+public:
+    MemoryTracker();
+
+    // getProperties2 may be null, the budget extension is only used when it is also enabled on the device
+    void init(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getProperties2, bool budgetExtension);
+
+    // first memory type allowed by typeBits with all the properties, UINT32_MAX when there is none
+    uint32_t findType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+    void record(VkDeviceMemory memory, VkDeviceSize size, uint32_t typeIndex, MemoryCategory category);
+    void release(VkDeviceMemory memory);
+
+    // refreshes the budget and warns about heaps over the threshold, allocations warn too
+    void updateBudget();
+    void report(std::ostream& out) const;
+
+    bool         budgetSupported() const                    { return budgetExtension; }
+    uint32_t     heapCount() const                          { return properties.memoryHeapCount; }
+    VkDeviceSize heapUsage(uint32_t heap) const;
+    VkDeviceSize heapBudget(uint32_t heap) const            { return budget[heap]; }
+    VkDeviceSize typeBytes(uint32_t type) const             { return typeAllocated[type]; }
+    VkDeviceSize categoryBytes(MemoryCategory category) const { return categoryAllocated[uint32_t(category)]; }
+    uint32_t     allocationCount() const                    { return uint32_t(allocations.size()); }
+    // UINT32_MAX for memory that is not tracked
+    uint32_t     heapOf(VkDeviceMemory memory) const;
+
+private:
+    struct Allocation
+    {
+        VkDeviceSize   size;
+        uint32_t       typeIndex;
+        MemoryCategory category;
+    };
+
+    VkPhysicalDevice                                  physicalDevice;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR       getProperties2;
+    bool                                              budgetExtension;
+    float                                             warnFraction;
+    VkPhysicalDeviceMemoryProperties                  properties;
+    std::unordered_map<VkDeviceMemory, Allocation>    allocations;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>     heapAllocated;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES>     typeAllocated;
+    std::array<VkDeviceSize, size_t(MemoryCategory::Count)> categoryAllocated;
+    // driver usage and budget at the last query, and what we had allocated at that time
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>     queriedUsage;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>     queriedAllocated;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>     budget;
+    std::array<bool, VK_MAX_MEMORY_HEAPS>             overBudget;
+
+    void checkHeap(uint32_t heap);
+};
+
+#endif //MEMORY_TRACKER_H
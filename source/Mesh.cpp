@@ -0,0 +1,85 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+VertexLayout meshVertexLayout(bool quantized)
+{
+    VertexLayout layout;
+    layout.binding   = 0;
+    layout.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    if (quantized) {
+        layout.stride = 2 * 2 * sizeof(uint16_t);
+        layout.attributes = {
+            {0, VK_FORMAT_R16G16_UNORM, 0,                    0, glm::vec2(0.0f), glm::vec2(1.0f)},
+            {1, VK_FORMAT_R16G16_UNORM, 2 * sizeof(uint16_t), 2, glm::vec2(0.0f), glm::vec2(1.0f)}
+        };
+    } else {
+        layout.stride = VERTEX_FLOATS * sizeof(float);
+        layout.attributes = {
+            {0, VK_FORMAT_R32G32_SFLOAT, 0,                 0, glm::vec2(0.0f), glm::vec2(1.0f)},
+            {1, VK_FORMAT_R32G32_SFLOAT, 2 * sizeof(float), 2, glm::vec2(0.0f), glm::vec2(1.0f)}
+        };
+    }
+    return layout;
+}
+
+VertexLayout instanceVertexLayout()
+{
+    VertexLayout layout;
+    layout.binding    = 1;
+    layout.stride     = sizeof(uint32_t);
+    layout.inputRate  = VK_VERTEX_INPUT_RATE_INSTANCE;
+    layout.attributes = { {2, VK_FORMAT_R32_UINT, 0, 0, glm::vec2(0.0f), glm::vec2(1.0f)} };
+    return layout;
+}
+
+void fitBounds(VertexLayout& layout, const std::vector<float>& vertices)
+{
+    size_t count = vertices.size() / VERTEX_FLOATS;
+    for (auto& attribute : layout.attributes) {
+        for (int c = 0; c < 2; c++) {
+            float lo = INFINITY, hi = -INFINITY;
+            for (size_t v = 0; v < count; v++) {
+                lo = std::min(lo, vertices[v * VERTEX_FLOATS + attribute.source + c]);
+                hi = std::max(hi, vertices[v * VERTEX_FLOATS + attribute.source + c]);
+            }
+            attribute.min[c]    = count ? lo : 0.0f;
+            attribute.extent[c] = count && hi > lo ? hi - lo : 1.0f;
+        }
+    }
+}
+
+void encodeVertices(const VertexLayout& layout, const std::vector<float>& vertices, std::vector<uint8_t>& out)
+{
+    size_t count = vertices.size() / VERTEX_FLOATS;
+    out.assign(count * layout.stride, 0);
+    for (size_t v = 0; v < count; v++) {
+        uint8_t* dst = out.data() + v * layout.stride;
+        for (const auto& attribute : layout.attributes) {
+            for (int c = 0; c < 2; c++) {
+                float normalized = (vertices[v * VERTEX_FLOATS + attribute.source + c] - attribute.min[c]) / attribute.extent[c];
+                if (attribute.format == VK_FORMAT_R16G16_UNORM) {
+                    uint16_t q = uint16_t(std::lround(std::min(std::max(normalized, 0.0f), 1.0f) * 65535.0f));
+                    memcpy(dst + attribute.offset + c * sizeof(uint16_t), &q, sizeof(q));
+                } else {
+                    memcpy(dst + attribute.offset + c * sizeof(float), &normalized, sizeof(normalized));
+                }
+            }
+        }
+    }
+}
+
+void describeVertexInput(const std::vector<VertexLayout>& layouts, 
+                         std::vector<VkVertexInputBindingDescription>& bindings, 
+                         std::vector<VkVertexInputAttributeDescription>& attributes)
+{
+    bindings.clear();
+    attributes.clear();
+    for (const auto& layout : layouts) {
+        bindings.push_back({layout.binding, layout.stride, layout.inputRate});
+        for (const auto& attribute : layout.attributes)
+            attributes.push_back({attribute.location, layout.binding, attribute.format, attribute.offset});
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef MESH_H
+#define MESH_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// floats per unpacked vertex on the CPU side: pos.xy, uv.xy
+const uint32_t VERTEX_FLOATS = 4;
+
+struct MeshRange
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t  vertexOffset;
+    uint32_t vertexCount;
+};
+
+struct VertexAttribute
+{
+    uint32_t  location;
+    VkFormat  format;
+    uint32_t  offset;
+    uint32_t  source;  // first float of this attribute in the unpacked vertex
+    glm::vec2 min;     // dequantized = min + stored * extent
+    glm::vec2 extent;
+};
+
+struct VertexLayout
+{
+    uint32_t                     binding;
+    uint32_t                     stride;
+    VkVertexInputRate            inputRate;
+    std::vector<VertexAttribute> attributes;
+};
+
+// pos + uv as R16G16_UNORM (8 bytes) or R32G32_SFLOAT (16 bytes)
+VertexLayout meshVertexLayout(bool quantized);
+// per-instance blade id
+VertexLayout instanceVertexLayout();
+
+// fits min/extent of every attribute to the data, must run before encodeVertices
+void fitBounds(VertexLayout& layout, const std::vector<float>& vertices);
+void encodeVertices(const VertexLayout& layout, const std::vector<float>& vertices, std::vector<uint8_t>& out);
+void describeVertexInput(const std::vector<VertexLayout>& layouts, 
+                         std::vector<VkVertexInputBindingDescription>& bindings, 
+                         std::vector<VkVertexInputAttributeDescription>& attributes);
+
+#endif //MESH_H
@@ -0,0 +1,197 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+VertexCacheStats analyzeVertexCache(const uint16_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    uint32_t transformed = 0;
+
+    // a vertex is in the FIFO while fewer than cacheSize misses happened since it was inserted
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint16_t v = indices[i];
+        if (cachedAt[v] == 0 || transformed - cachedAt[v] >= cacheSize) {
+            transformed++;
+            cachedAt[v] = transformed;
+        }
+    }
+
+    uint32_t used = 0;
+    for (uint32_t at : cachedAt)
+        used += at != 0;
+
+    VertexCacheStats stats;
+    stats.transformed = transformed;
+    stats.acmr = indexCount ? float(transformed) / float(indexCount / 3) : 0.0f;
+    stats.atvr = used ? float(transformed) / float(used) : 0.0f;
+    return stats;
+}
+
+static float forsythVertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+    const float cacheDecayPower   = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the triangle just emitted, deliberately scored low so the strip does not turn back on itself
+            score = lastTriangleScore;
+        } else {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+        }
+    }
+    // favour vertices with few triangles left so they get finished off and leave no stragglers
+    score += valenceBoostScale * std::pow(float(remainingTriangles), -valenceBoostPower);
+    return score;
+}
+
+void optimizeVertexCache(uint16_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency, the live part of each list shrinks as triangles are emitted
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint16_t v = indices[t * 3 + k];
+            adjacency[firstTriangle[v] + filled[v]++] = t;
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float>   vertexScore(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool>  emitted(triangleCount, false);
+    for (uint32_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    std::vector<uint16_t> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint16_t> result;
+    result.reserve(triangleCount * 3);
+
+    uint32_t best = 0;
+    uint32_t scanCursor = 0;
+    for (uint32_t t = 1; t < triangleCount; t++) {
+        if (triangleScore[t] > triangleScore[best])
+            best = t;
+    }
+
+    while (best != UINT32_MAX) {
+        const uint16_t* tri = indices + best * 3;
+        emitted[best] = true;
+        result.insert(result.end(), tri, tri + 3);
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint16_t v = tri[k];
+            uint32_t* list = adjacency.data() + firstTriangle[v];
+            uint32_t* end  = std::remove(list, list + remaining[v], best);
+            remaining[v] = uint32_t(end - list);
+        }
+
+        // the emitted triangle goes to the front of the LRU cache, the rest keeps its order
+        nextCache.assign(tri, tri + 3);
+        for (uint16_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint16_t v = nextCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? int32_t(i) : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+        if (nextCache.size() > FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        std::swap(cache, nextCache);
+
+        // only triangles touching the cache changed score, the best of them is the next candidate
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (uint16_t v : cache) {
+            for (uint32_t i = 0; i < remaining[v]; i++) {
+                uint32_t t = adjacency[firstTriangle[v] + i];
+                triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        // nothing adjacent to the cache is left, restart from the next unemitted triangle
+        if (best == UINT32_MAX) {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor < triangleCount)
+                best = scanCursor;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeVertexFetch(float* vertices, uint16_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint16_t v = indices[i];
+        if (remap[v] == UINT32_MAX)
+            remap[v] = next++;
+        indices[i] = uint16_t(remap[v]);
+    }
+    // unreferenced vertices keep their relative order at the end
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == UINT32_MAX)
+            remap[v] = next++;
+    }
+
+    std::vector<float> reordered(size_t(vertexCount) * VERTEX_FLOATS);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        std::copy(vertices + v * VERTEX_FLOATS, vertices + (v + 1) * VERTEX_FLOATS, reordered.begin() + remap[v] * VERTEX_FLOATS);
+    std::copy(reordered.begin(), reordered.end(), vertices);
+}
+
+void optimizeMeshRange(const MeshRange& range, std::vector<float>& vertices, std::vector<uint16_t>& indices,
+                       uint32_t instances, std::ostream& out)
+{
+    uint16_t* rangeIndices  = indices.data() + range.firstIndex;
+    float*    rangeVertices = vertices.data() + size_t(range.vertexOffset) * VERTEX_FLOATS;
+
+    VertexCacheStats before = analyzeVertexCache(rangeIndices, range.indexCount, range.vertexCount);
+    optimizeVertexCache(rangeIndices, range.indexCount, range.vertexCount);
+    optimizeVertexFetch(rangeVertices, rangeIndices, range.indexCount, range.vertexCount);
+    VertexCacheStats after = analyzeVertexCache(rangeIndices, range.indexCount, range.vertexCount);
+
+    out << std::fixed << std::setprecision(3)
+        << "Mesh " << range.vertexCount << " vertices, " << range.indexCount / 3 << " triangles: "
+        << "ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << ", "
+        << instances << " instances transform " << uint64_t(before.transformed) * instances << " -> " 
+        << uint64_t(after.transformed) * instances << " vertices" << std::endl;
+    out.unsetf(std::ios::fixed);
+}
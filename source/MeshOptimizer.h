@@ -0,0 +1,36 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "Mesh.h"
+
+// size of the simulated post-transform cache used by the analyzer (FIFO, like most desktop GPUs)
+const uint32_t ANALYZE_CACHE_SIZE = 16;
+// size of the LRU cache the Forsyth scoring is tuned for
+const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+struct VertexCacheStats
+{
+    uint32_t transformed; // vertex shader invocations for one draw
+    float    acmr;        // transformed vertices per triangle, 0.5 is the ideal for a regular grid
+    float    atvr;        // transformed vertices per unique vertex, 1.0 is the ideal
+};
+
+VertexCacheStats analyzeVertexCache(const uint16_t* indices, uint32_t indexCount, uint32_t vertexCount, 
+                                    uint32_t cacheSize = ANALYZE_CACHE_SIZE);
+// Forsyth "linear-speed vertex cache optimisation", reorders triangles in place
+void optimizeVertexCache(uint16_t* indices, uint32_t indexCount, uint32_t vertexCount);
+// renumbers vertices in first-use order so fetches walk the vertex buffer linearly,
+// vertices has VERTEX_FLOATS floats per vertex
+void optimizeVertexFetch(float* vertices, uint16_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+// runs both passes on a range with range-local indices and prints the cache stats before and after
+void optimizeMeshRange(const MeshRange& range, std::vector<float>& vertices, std::vector<uint16_t>& indices,
+                       uint32_t instances, std::ostream& out);
+
+#endif //MESH_OPTIMIZER_H
@@ -0,0 +1,148 @@
+#include "NumberReader.h"
+
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// bytes per parse job, large enough that a job is not dominated by scheduling
+const size_t PARSE_CHUNK = 1 << 20;
+
+MappedFile::MappedFile(const std::string& path) : begin(nullptr), length(0), mapped(false)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("MappedFile: can't open " + path);
+    struct stat info{};
+    bool known = fstat(fd, &info) == 0;
+    if (known && info.st_size > 0) {
+        void* address = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            // every chunk is touched at once by the parse jobs
+            madvise(address, size_t(info.st_size), MADV_WILLNEED);
+            begin  = static_cast<const char*>(address);
+            length = size_t(info.st_size);
+            mapped = true;
+        }
+    }
+    close(fd);
+    if (mapped || (known && info.st_size == 0))
+        return;
+#endif
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        throw std::runtime_error("MappedFile: can't open " + path);
+    buffer.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), std::streamsize(buffer.size()));
+    begin  = buffer.data();
+    length = buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef __linux__
+    if (mapped)
+        munmap(const_cast<char*>(begin), length);
+#endif
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// chunk boundaries just past a newline, a file without newlines is one chunk
+static std::vector<size_t> splitChunks(const char* data, size_t size)
+{
+    std::vector<size_t> bounds = { 0 };
+    while (bounds.back() + PARSE_CHUNK < size) {
+        const char* newline = static_cast<const char*>(memchr(data + bounds.back() + PARSE_CHUNK, '\n',
+                                                              size - bounds.back() - PARSE_CHUNK));
+        if (!newline)
+            break;
+        bounds.push_back(size_t(newline - data) + 1);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+static uint64_t countTokens(const char* first, const char* last)
+{
+    uint64_t count = 0;
+    bool inToken = false;
+    for (const char* c = first; c < last; c++) {
+        bool space = isSpace(*c);
+        count += !space && !inToken;
+        inToken = !space;
+    }
+    return count;
+}
+
+template <typename T>
+void readNumbers(JobSystem& jobs, const std::string& path, std::vector<T>& values, NumberReadStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    MappedFile file(path);
+    const char* data = file.data();
+    std::vector<size_t> bounds = splitChunks(data, file.size());
+    uint32_t chunkCount = uint32_t(bounds.size() - 1);
+
+    // count pass, then every chunk knows where its values start
+    std::vector<uint64_t> firsts(chunkCount + 1, 0);
+    jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++)
+            firsts[chunk + 1] = countTokens(data + bounds[chunk], data + bounds[chunk + 1]);
+    });
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        firsts[chunk + 1] += firsts[chunk];
+    values.resize(size_t(firsts[chunkCount]));
+
+    // offset of the first bad token of each chunk, SIZE_MAX when the chunk parsed
+    std::vector<size_t> errors(chunkCount, SIZE_MAX);
+    jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            const char* c    = data + bounds[chunk];
+            const char* last = data + bounds[chunk + 1];
+            T* out = values.data() + firsts[chunk];
+            for (;;) {
+                while (c < last && isSpace(*c))
+                    c++;
+                if (c == last)
+                    break;
+                std::from_chars_result result = std::from_chars(c, last, *out++);
+                if (result.ec != std::errc() || (result.ptr < last && !isSpace(*result.ptr))) {
+                    errors[chunk] = size_t(c - data);
+                    break;
+                }
+                c = result.ptr;
+            }
+        }
+    });
+
+    for (size_t offset : errors) {
+        if (offset != SIZE_MAX)
+            throw std::runtime_error("readNumbers: bad number in " + path + " at byte " + std::to_string(offset));
+    }
+    if (stats) {
+        stats->bytes   = file.size();
+        stats->values  = values.size();
+        stats->chunks  = chunkCount;
+        stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+template void readNumbers<float>(JobSystem&, const std::string&, std::vector<float>&, NumberReadStats*);
+template void readNumbers<uint16_t>(JobSystem&, const std::string&, std::vector<uint16_t>&, NumberReadStats*);
+template void readNumbers<uint32_t>(JobSystem&, const std::string&, std::vector<uint32_t>&, NumberReadStats*);
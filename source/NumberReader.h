@@ -0,0 +1,52 @@
+#ifndef NUMBER_READER_H
+#define NUMBER_READER_H
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "JobSystem.h"
+
+// Read-only view of a whole file, memory mapped where the platform allows it.
+class MappedFile
+{
+public:
+    // throws std::runtime_error when the file can't be opened
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return begin; }
+    size_t      size() const { return length; }
+
+private:
+    const char*       begin;
+    size_t            length;
+    bool              mapped;
+    // contents read into memory when mapping is not available
+    std::vector<char> buffer;
+};
+
+struct NumberReadStats
+{
+    uint64_t bytes;
+    uint64_t values;
+    uint32_t chunks;
+    double   seconds;
+
+    double megabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+};
+
+// Whitespace separated numbers of a text file, parsed with std::from_chars. The file is split at
+// newlines into chunks that are counted, then parsed in parallel straight into the preallocated
+// output. Throws std::runtime_error with the byte offset of the first token that is not a T.
+// Instantiated for float, uint16_t and uint32_t.
+template <typename T>
+void readNumbers(JobSystem& jobs, const std::string& path, std::vector<T>& values, NumberReadStats* stats = nullptr);
+
+#endif //NUMBER_READER_H
@@ -0,0 +1,195 @@
+#include "SceneConfig.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "json.hpp"
+
+using nlohmann::json;
+
+AssetId AssetCache::add(const std::string& path)
+{
+    // "a/../b.png" and "b.png" are the same file
+    std::string key = std::filesystem::path(path).lexically_normal().generic_string();
+    auto it = ids.find(key);
+    if (it == ids.end()) {
+        it = ids.emplace(key, AssetId(entries.size())).first;
+        entries.emplace_back();
+        entries.back().path = key;
+    }
+    entries[it->second].references++;
+    return it->second;
+}
+
+const std::vector<unsigned char>& AssetCache::bytes(AssetId id)
+{
+    Entry& entry = entries[id];
+    std::call_once(entry.loaded, [&entry]() {
+        std::ifstream file(entry.path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            throw std::runtime_error("AssetCache: can't open " + entry.path);
+        entry.bytes.resize(size_t(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(entry.bytes.data()), std::streamsize(entry.bytes.size()));
+    });
+    return entry.bytes;
+}
+
+void AssetCache::report(std::ostream& out) const
+{
+    uint32_t references = 0;
+    for (const Entry& entry : entries)
+        references += entry.references;
+    out << "Assets: " << references << " references to " << entries.size() << " files" << std::endl;
+}
+
+std::vector<float> SceneConstants::values() const
+{
+    return { windPeriod, windSpatial, windFrequency, windAmplitude, bladeScale,
+             groundColor[0], groundColor[1], groundColor[2] };
+}
+
+template <typename T>
+static void read(const json& node, const char* key, T& value)
+{
+    auto it = node.find(key);
+    if (it != node.end())
+        value = it->get<T>();
+}
+
+static void readFloats(const json& node, const char* key, float* values, size_t count)
+{
+    auto it = node.find(key);
+    if (it == node.end())
+        return;
+    if (!it->is_array() || it->size() != count)
+        throw std::runtime_error(std::string(key) + " needs " + std::to_string(count) + " numbers");
+    for (size_t i = 0; i < count; i++)
+        values[i] = (*it)[i].get<float>();
+}
+
+static const json& section(const json& root, const char* key)
+{
+    static const json empty = json::object();
+    auto it = root.find(key);
+    if (it == root.end())
+        return empty;
+    if (!it->is_object())
+        throw std::runtime_error(std::string(key) + " must be an object");
+    return *it;
+}
+
+static VkPresentModeKHR presentMode(const std::string& name)
+{
+    if (name == "immediate")    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (name == "mailbox")      return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "fifo")         return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo_relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    throw std::runtime_error("unknown present mode " + name);
+}
+
+static void check(bool condition, const char* message)
+{
+    if (!condition)
+        throw std::runtime_error(message);
+}
+
+SceneConfig loadSceneConfig(const std::string& path, AssetCache& assets)
+{
+    json root = json::object();
+    std::filesystem::path directory;
+    if (!path.empty()) {
+        std::ifstream file(path);
+        if (!file.is_open())
+            throw std::runtime_error("loadSceneConfig: can't open " + path);
+        try {
+            file >> root;
+        } catch (const std::exception& error) {
+            throw std::runtime_error("loadSceneConfig: " + path + ": " + error.what());
+        }
+        directory = std::filesystem::path(path).parent_path();
+    }
+    auto asset = [&assets, &directory](const std::string& file) {
+        return assets.add((directory / file).string());
+    };
+
+    SceneConfig config;
+    try {
+        const json& window = section(root, "window");
+        read(window, "width", config.window.width);
+        read(window, "height", config.window.height);
+        read(window, "framesInFlight", config.window.framesInFlight);
+        if (window.contains("presentMode"))
+            config.window.presentMode = presentMode(window["presentMode"].get<std::string>());
+
+        const json& camera = section(root, "camera");
+        readFloats(camera, "target", config.camera.target, 3);
+        readFloats(camera, "offset", config.camera.offset, 3);
+        read(camera, "fov", config.camera.fovDegrees);
+        read(camera, "near", config.camera.nearPlane);
+        read(camera, "far", config.camera.farPlane);
+        read(camera, "speed", config.camera.speed);
+
+        const json& field = section(root, "field");
+        read(field, "radius", config.field.radius);
+        read(field, "bladesPerSide", config.field.bladesPerSide);
+        read(field, "maxChunkUploads", config.field.maxChunkUploads);
+
+        const json& lod = section(root, "lod");
+        readFloats(lod, "minScreenHeight", config.lod.minScreenHeight, BLADE_LOD_LEVELS);
+        read(lod, "hysteresis", config.lod.hysteresis);
+
+        const json& wind = section(root, "wind");
+        read(wind, "period", config.constants.windPeriod);
+        read(wind, "spatial", config.constants.windSpatial);
+        read(wind, "frequency", config.constants.windFrequency);
+        read(wind, "amplitude", config.constants.windAmplitude);
+        const json& windField = section(wind, "field");
+        read(windField, "extent", config.windField.extent);
+        read(windField, "scrollSpeed", config.windField.scrollSpeed);
+        read(windField, "octaves", config.windField.octaves);
+        read(windField, "gustSpeed", config.windField.gustSpeed);
+        read(windField, "gustWidth", config.windField.gustWidth);
+        read(windField, "gustStrength", config.windField.gustStrength);
+        read(section(root, "blade"), "scale", config.constants.bladeScale);
+        readFloats(section(root, "ground"), "color", config.constants.groundColor, 3);
+
+        // built-in paths are relative to the build directory, like the shaders
+        const json& mesh = section(root, "mesh");
+        config.vertices = mesh.contains("vertices") ? asset(mesh["vertices"].get<std::string>()) : assets.add("../resource/vertex3.txt");
+        config.indices  = mesh.contains("indices") ? asset(mesh["indices"].get<std::string>()) : assets.add("../resource/index3.txt");
+
+        if (root.contains("species")) {
+            for (const json& species : root["species"]) {
+                SpeciesConfig entry = { NO_ASSET, { 1.0f, 1.0f, 1.0f } };
+                entry.texture = asset(species.at("texture").get<std::string>());
+                readFloats(species, "tint", entry.tint, 3);
+                config.species.push_back(entry);
+            }
+        } else {
+            AssetId texture = assets.add("../resource/grass-texture.png");
+            config.species = {
+                { texture, { 1.0f,  1.0f,  1.0f  } }, // meadow
+                { texture, { 1.25f, 1.0f,  0.45f } }, // dry
+                { texture, { 0.7f,  0.9f,  0.8f  } }, // wet
+            };
+        }
+
+        check(config.window.width > 0 && config.window.height > 0, "window size must not be zero");
+        check(config.window.framesInFlight >= 1 && config.window.framesInFlight <= 8, "framesInFlight must be 1 to 8");
+        check(config.camera.nearPlane > 0.0f && config.camera.farPlane > config.camera.nearPlane, "camera planes out of order");
+        check(config.field.radius >= 0 && config.field.radius <= 16, "field radius must be 0 to 16");
+        check(config.field.bladesPerSide >= 1 && config.field.bladesPerSide <= 64, "bladesPerSide must be 1 to 64");
+        check(config.field.maxChunkUploads >= 1, "maxChunkUploads must be at least 1");
+        check(config.constants.windPeriod > 0.0f, "wind period must be positive");
+        check(config.windField.extent > 0.0f && config.windField.gustWidth > 0.0f, "wind field extent and gustWidth must be positive");
+        check(config.windField.octaves >= 1 && config.windField.octaves <= MAX_WIND_OCTAVES, "wind field octaves must be 1 to 4");
+        check(config.windField.gustStrength >= 0.0f && config.windField.gustStrength <= 1.0f, "wind field gustStrength must be 0 to 1");
+        // the species index is packed into 8 bits of BladeInstance::variation
+        check(!config.species.empty() && config.species.size() <= 256, "there must be 1 to 256 species");
+    } catch (const std::exception& error) {
+        throw std::runtime_error("loadSceneConfig: " + path + ": " + error.what());
+    }
+    return config;
+}
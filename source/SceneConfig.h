@@ -0,0 +1,112 @@
+#ifndef SCENE_CONFIG_H
+#define SCENE_CONFIG_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <ostream>
+
+#include "BladeLod.h"
+#include "WindField.h"
+
+typedef uint32_t AssetId;
+const AssetId NO_ASSET = UINT32_MAX;
+
+// Files the scene refers to. Every path is registered once however often it is referenced, and its
+// bytes are read the first time they are asked for, from any thread.
+class AssetCache
+{
+public:
+    AssetId add(const std::string& path);
+    const std::string&                path(AssetId id) const { return entries[id].path; }
+    // throws std::runtime_error when the file can't be read
+    const std::vector<unsigned char>& bytes(AssetId id);
+
+    uint32_t size() const { return uint32_t(entries.size()); }
+    void     report(std::ostream& out) const;
+
+private:
+    struct Entry
+    {
+        std::string                path;
+        std::once_flag             loaded;
+        std::vector<unsigned char> bytes;
+        uint32_t                   references = 0;
+    };
+
+    // a deque keeps entries in place while others are added
+    std::deque<Entry>                        entries;
+    std::unordered_map<std::string, AssetId> ids;
+};
+
+// values baked into the shaders as specialization constants, ids follow the member order
+struct SceneConstants
+{
+    float windPeriod    = 75.0f;
+    float windSpatial   = 17.0f;  // phase change per unit of blade x
+    float windFrequency = 10.0f;  // phase change per unit of blade height
+    float windAmplitude = 0.1f;
+    float bladeScale    = 0.5f;   // blade height in world units at instance scale 1
+    float groundColor[3] = { 0.6f, 0.3f, 0.0f };
+
+    std::vector<float> values() const;
+};
+
+struct WindowConfig
+{
+    uint32_t         width          = 800;
+    uint32_t         height         = 800;
+    // used when the surface supports it, otherwise mailbox, immediate, then fifo
+    VkPresentModeKHR presentMode    = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t         framesInFlight = 3;
+};
+
+struct CameraConfig
+{
+    float target[3]  = { 0.0f, 0.0f, 0.0f };
+    float offset[3]  = { 0.0f, 2.5f, -6.0f }; // eye position relative to the target
+    float fovDegrees = 45.0f;
+    float nearPlane  = 0.1f;
+    float farPlane   = 10.0f;
+    float speed      = 3.0f;                  // world units per second
+};
+
+struct FieldConfig
+{
+    int32_t  radius          = 2;   // chunks around the camera chunk
+    uint32_t bladesPerSide   = 10;  // blades per chunk side, the density
+    uint32_t maxChunkUploads = 4;   // chunks uploaded per frame
+};
+
+// every species is one layer of the grass texture array, the tint lets species share a source image
+struct SpeciesConfig
+{
+    AssetId texture;
+    float   tint[3];
+};
+
+struct SceneConfig
+{
+    WindowConfig               window;
+    CameraConfig               camera;
+    FieldConfig                field;
+    BladeLodSettings           lod;
+    WindFieldSettings          windField;
+    SceneConstants             constants;
+    AssetId                    vertices = NO_ASSET;
+    AssetId                    indices  = NO_ASSET;
+    std::vector<SpeciesConfig> species;
+};
+
+// Reads a JSON scene description, every key is optional and falls back to the built-in scene.
+// Asset paths are relative to the directory of the file. An empty path gives the built-in scene.
+// Throws std::runtime_error on syntax errors, wrong value types and out of range values.
+SceneConfig loadSceneConfig(const std::string& path, AssetCache& assets);
+
+#endif //SCENE_CONFIG_H
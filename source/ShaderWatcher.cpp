@@ -0,0 +1,132 @@
+#include "ShaderWatcher.h"
+
+#include <iostream>
+#include <cstdio>
+#include <chrono>
+#include <set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static const ShaderBuild SHADER_BUILDS[] = {
+    { "vertex.vert",   "vert.spv",            "" },
+    { "vertex.vert",   "vert_vat.spv",        "-DVERTEX_ANIMATION" },
+    { "fragment.frag", "frag.spv",            "" },
+    { "fragment.frag", "frag_nodiscard.spv",  "-DNO_DISCARD" },
+    { "depth.frag",    "depth.frag.spv",      "" },
+    { "depth.frag",    "depth_nodiscard.spv", "-DNO_DISCARD" },
+    { "ground.vert",   "ground.vert.spv",     "" },
+    { "ground.frag",   "ground.frag.spv",     "" },
+    { "mipmap.comp",   "mipmap.comp.spv",     "" },
+    { "simulate.comp", "simulate.comp.spv",   "" },
+};
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) :
+    directory(directory), watchFd(-1), stopping(false)
+{
+#ifdef __linux__
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchFd >= 0 && inotify_add_watch(watchFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(watchFd);
+        watchFd = -1;
+    }
+#endif
+    if (watchFd < 0) {
+        std::cerr << "Shader reload: cannot watch " << directory << ", reloading is disabled" << std::endl;
+        return;
+    }
+    std::cerr << "Shader reload: watching " << directory << std::endl;
+    thread = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    stopping = true;
+    if (thread.joinable())
+        thread.join();
+#ifdef __linux__
+    if (watchFd >= 0)
+        close(watchFd);
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::takeRebuilt()
+{
+    std::lock_guard<std::mutex> lock(rebuiltMutex);
+    std::vector<std::string> result;
+    result.swap(rebuilt);
+    return result;
+}
+
+bool ShaderWatcher::compile(const ShaderBuild& build)
+{
+#ifdef __linux__
+    // compile next to the binary and rename, so a pipeline build never reads a half written file
+    std::string binary = directory + "/" + build.binary;
+    std::string temp   = binary + ".tmp";
+    std::string command = std::string("glslangValidator -V ") + build.defines + " \"" + directory + "/" + build.source + 
+                          "\" -o \"" + temp + "\" 2>&1";
+
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr)
+        return false;
+    std::string output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+        output += buffer;
+    int status = pclose(pipe);
+
+    if (status != 0) {
+        std::cerr << "Shader reload: " << build.source << " -> " << build.binary << " failed, keeping the old pipelines\n" << output;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return std::rename(temp.c_str(), binary.c_str()) == 0;
+#else
+    return false;
+#endif
+}
+
+void ShaderWatcher::watchLoop()
+{
+#ifdef __linux__
+    alignas(inotify_event) char events[4096];
+    while (!stopping) {
+        pollfd pfd = { watchFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        // editors save in bursts (write, rename, chmod), collect everything that arrives shortly after
+        std::set<std::string> changed;
+        auto quietUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        while (std::chrono::steady_clock::now() < quietUntil) {
+            ssize_t length = read(watchFd, events, sizeof(events));
+            if (length <= 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            for (char* ptr = events; ptr < events + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                if (event->len > 0)
+                    changed.insert(event->name);
+                ptr += sizeof(inotify_event) + event->len;
+            }
+            quietUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        }
+
+        std::vector<std::string> binaries;
+        for (const ShaderBuild& build : SHADER_BUILDS) {
+            if (changed.count(build.source) && compile(build))
+                binaries.push_back(directory + "/" + build.binary);
+        }
+        if (binaries.empty())
+            continue;
+
+        std::lock_guard<std::mutex> lock(rebuiltMutex);
+        rebuilt.insert(rebuilt.end(), binaries.begin(), binaries.end());
+    }
+#endif
+}
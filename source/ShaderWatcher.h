@@ -0,0 +1,45 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// how a shader binary is produced from its source, mirrors the compile_shader calls in CMakeLists.txt
+struct ShaderBuild
+{
+    const char* source;
+    const char* binary;
+    const char* defines;
+};
+
+// Development helper: watches the shader directory with inotify and recompiles the binaries of every
+// changed source with glslangValidator on its own thread. The render loop only picks up the list of
+// rebuilt binaries, it never waits for the compiler.
+class ShaderWatcher
+{
+public:
+    explicit ShaderWatcher(const std::string& directory);
+    ~ShaderWatcher();
+
+    bool active() const { return watchFd >= 0; }
+    // paths of binaries rebuilt since the last call, in the form the pipelines load them ("<directory>/<binary>")
+    std::vector<std::string> takeRebuilt();
+
+private:
+    std::string              directory;
+    int                      watchFd;
+    std::thread              thread;
+    std::atomic<bool>        stopping;
+    std::mutex               rebuiltMutex;
+    std::vector<std::string> rebuilt;
+
+    void watchLoop();
+    bool compile(const ShaderBuild& build);
+};
+
+#endif //SHADER_WATCHER_H
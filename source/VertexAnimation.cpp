@@ -0,0 +1,69 @@
+#include "VertexAnimation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const float TWO_PI = 6.28318530718f;
+
+static int8_t quantize(float value)
+{
+    return int8_t(std::lround(std::max(-1.0f, std::min(1.0f, value)) * 127.0f));
+}
+
+// what the shader reads back from an R8_SNORM texel
+static float dequantize(int8_t texel)
+{
+    return std::max(-1.0f, texel / 127.0f);
+}
+
+void VertexAnimation::bake(JobSystem& jobs, const std::vector<float>& vertices, const SceneConstants& constants,
+                           uint32_t frames)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    vertexCount = uint32_t(vertices.size() / VERTEX_FLOATS);
+    frameCount  = frames;
+    data.assign(size_t(vertexCount) * frameCount, 0);
+
+    // the phase of a vertex does not change over the loop, only the time term of vertex.vert does
+    std::vector<float> errors(vertexCount, 0.0f);
+    jobs.parallelFor(vertexCount, 256, [this, &vertices, &constants, &errors](uint32_t begin, uint32_t end) {
+        for (uint32_t v = begin; v < end; v++) {
+            float x = vertices[v * VERTEX_FLOATS + 0] * constants.bladeScale;
+            float y = vertices[v * VERTEX_FLOATS + 1] * constants.bladeScale;
+            float offset = constants.windSpatial * x / constants.windPeriod + y * constants.windFrequency;
+            for (uint32_t f = 0; f < frameCount; f++)
+                data[size_t(f) * vertexCount + v] = quantize(std::sin(TWO_PI * f / frameCount + offset));
+
+            // blending is worst halfway between two frames
+            float error = 0.0f;
+            for (uint32_t f = 0; f < frameCount; f++) {
+                float a = dequantize(data[size_t(f) * vertexCount + v]);
+                float b = dequantize(data[size_t((f + 1) % frameCount) * vertexCount + v]);
+                float exact = std::sin(TWO_PI * (f + 0.5f) / frameCount + offset);
+                error = std::max(error, std::abs(0.5f * (a + b) - exact));
+            }
+            errors[v] = error;
+        }
+    });
+    maxError = errors.empty() ? 0.0f : *std::max_element(errors.begin(), errors.end());
+    bakeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VertexAnimation::report(std::ostream& out) const
+{
+    out << "Vertex animation: " << vertexCount << " vertices x " << frameCount << " frames, " << bytes()
+        << " bytes, baked in " << bakeSeconds * 1000.0 << " ms, max error " << maxError * 100.0f
+        << "% of the amplitude" << std::endl;
+}
+
+void VertexAnimation::reportSavings(std::ostream& out, uint64_t analyticVertices, uint64_t bakedVertices)
+{
+    uint64_t total = analyticVertices + bakedVertices;
+    if (total == 0)
+        return;
+    uint64_t saved = bakedVertices * (ANALYTIC_FLUTTER_ALU - BAKED_FLUTTER_ALU);
+    out << "Vertex animation: " << bakedVertices << " of " << total << " blade vertices/frame played back ("
+        << ANALYTIC_FLUTTER_ALU << " alu + sin + " << ANALYTIC_FLUTTER_LOADS << " loads -> " << BAKED_FLUTTER_ALU
+        << " alu + " << BAKED_FLUTTER_FETCHES << " fetches per vertex), " << saved << " alu/frame saved" << std::endl;
+}
@@ -0,0 +1,58 @@
+#ifndef VERTEX_ANIMATION_H
+#define VERTEX_ANIMATION_H
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "SceneConfig.h"
+
+// frames per loop, enough that blending neighbours stays within the 8 bit quantization
+const uint32_t VERTEX_ANIMATION_FRAMES = 32;
+// per vertex cost of the flutter in vertex.vert, scalar ops counted from the GLSL: the analytic path
+// evaluates a sin and samples the wind field (4 storage loads), the playback fetches two baked frames
+const uint32_t ANALYTIC_FLUTTER_ALU   = 41;
+const uint32_t ANALYTIC_FLUTTER_LOADS = 4;
+const uint32_t BAKED_FLUTTER_ALU      = 15;
+const uint32_t BAKED_FLUTTER_FETCHES  = 2;
+
+// One loop of the blade flutter baked per vertex into a texture, row f holds frame f for every
+// vertex of the mesh so the vertex shader fetches its column by gl_VertexIndex. A texel is the sine
+// of the flutter at scene scale (R8_SNORM), the shader scales it by the amplitude and the height.
+// The loop is one wind period, each blade plays it from its own phase so neighbours stay apart.
+// Baked at instance scale 1 with the wind field at its average (strength 0.5, no turbulence); the
+// field still leans the blades through the simulation. A gust keeps the baked shape and only
+// speeds it up, the period and the amplitude stay specialization constants of the shader.
+class VertexAnimation
+{
+public:
+    VertexAnimation() : vertexCount(0), frameCount(0), bakeSeconds(0.0), maxError(0.0f) {}
+
+    // vertices are VERTEX_FLOATS per vertex, positions at instance scale 1 before BLADE_SCALE
+    void bake(JobSystem& jobs, const std::vector<float>& vertices, const SceneConstants& constants,
+              uint32_t frames = VERTEX_ANIMATION_FRAMES);
+
+    uint32_t                   width() const  { return vertexCount; }
+    uint32_t                   frames() const { return frameCount; }
+    // frames() rows of width() texels
+    const std::vector<int8_t>& texels() const { return data; }
+    size_t                     bytes() const  { return data.size(); }
+
+    void report(std::ostream& out) const;
+    // the vertices drawn in a frame with either path
+    static void reportSavings(std::ostream& out, uint64_t analyticVertices, uint64_t bakedVertices);
+
+private:
+    uint32_t            vertexCount;
+    uint32_t            frameCount;
+    std::vector<int8_t> data;
+    double              bakeSeconds;
+    // largest difference between the played back and the analytic flutter, in units of amplitude
+    float               maxError;
+};
+
+#endif //VERTEX_ANIMATION_H
@@ -4,22 +4,46 @@
 
 VulkanApp::~VulkanApp()
 {
-    vkFreeMemory(device, vertexMemory, NULL);
+    shaderWatcher.reset();
+    finishInitialUpload();
+    finishCapture();
+    freeMemory(vertexMemory);
     vkDestroyBuffer(device, vertexBuffer, NULL);
-    vkFreeMemory(device, idxMemory, NULL);
+    freeMemory(idxMemory);
     vkDestroyBuffer(device, idxBuffer, NULL);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    freeMemory(stagingBufferMemory);
     vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, textureImageMemory, NULL);
+    freeMemory(textureImageMemory);
     vkDestroySampler(device, textureSampler, nullptr);
     vkDestroyImage(device, textureImage, NULL);
     vkDestroyImageView(device, textureImageView, nullptr);
-    for (size_t i = 0; i < screenBufferResources.swapChainImages.size(); i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+    vkDestroySampler(device, vertexAnimationSampler, nullptr);
+    vkDestroyImageView(device, vertexAnimationView, nullptr);
+    vkDestroyImage(device, vertexAnimationImage, nullptr);
+    freeMemory(vertexAnimationMemory);
+    vkDestroyBuffer(device, uniformBuffer, nullptr);
+    freeMemory(uniformBufferMemory);
+    for (size_t i = 0; i < instanceBuffers.size(); i++) {
+        vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+        freeMemory(instanceBuffersMemory[i]);
+    }
+    for (size_t i = 0; i < uploadBuffers.size(); i++) {
+        vkDestroyBuffer(device, uploadBuffers[i], nullptr);
+        freeMemory(uploadBuffersMemory[i]);
     }
+    vkDestroyBuffer(device, bladePoolBuffer, nullptr);
+    freeMemory(bladePoolMemory);
+    vkDestroyBuffer(device, bladeStateBuffer, nullptr);
+    freeMemory(bladeStateMemory);
+    vkDestroyBuffer(device, windBuffer, nullptr);
+    freeMemory(windMemory);
+    destroySimulation();
+    if (pipelineStatistics)
+        vkDestroyQueryPool(device, statisticsPool, nullptr);
+    if (timestamps)
+        vkDestroyQueryPool(device, timestampPool, nullptr);
 
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    descriptors.destroy();
 
 
     auto func = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
@@ -28,75 +52,111 @@ VulkanApp::~VulkanApp()
     func(instance, debugReportCallback, NULL);
 
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, transferCommandPool, nullptr);
+    vkDestroyCommandPool(device, computeCommandPool, nullptr);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         vkDestroySemaphore(device, syncObj.renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device, syncObj.imageAvailableSemaphores[i], nullptr);
+        vkDestroySemaphore(device, syncObj.uploadFinishedSemaphores[i], nullptr);
+        vkDestroySemaphore(device, syncObj.simulationFinishedSemaphores[i], nullptr);
+        vkDestroySemaphore(device, syncObj.simulationUploadSemaphores[i], nullptr);
+        vkDestroySemaphore(device, syncObj.stateReleasedSemaphores[i], nullptr);
         vkDestroyFence(device, syncObj.inFlightFences[i], nullptr);
     }
-    
-    for (auto framebuffer : screenBufferResources.swapChainFramebuffers) {
-      vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
 
+    retireRenderTargets();
+    deletionQueue.flush();
     for (auto imageView : screenBufferResources.swapChainImageViews) {
       vkDestroyImageView(device, imageView, nullptr);
     }
     
-    vkDestroyPipeline(device, pipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
+    destroyPipelineCache();
     
     vkDestroySwapchainKHR(device, screenBufferResources.swapChain, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
+    for (size_t i = 0; i < offscreenMemory.size(); i++) {
+        vkDestroyImage(device, screenBufferResources.swapChainImages[i], nullptr);
+        freeMemory(offscreenMemory[i]);
+    }
 
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-    
     vkDestroyDevice(device, nullptr);
     vkDestroyInstance(instance, nullptr);
     
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!options.headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
 
 void VulkanApp::Init()
 {
-    glfwInit();
+    window = nullptr;
+    surface = VK_NULL_HANDLE;
+    screenBufferResources.swapChain = VK_NULL_HANDLE;
+    if (!options.headless)
+        glfwInit();
     initResources();
     createInstance();
 
     initDebugReportCallback();
     createPhysicalDevice();
-    createWindow();
+    if (!options.headless)
+        createWindow();
     getQueueFamily();
     createDevice();
-    createSwapchain();
-
-    createRenderPass();
+    packVertices();
+    if (options.headless)
+        createOffscreenTargets();
+    else
+        createSwapchain();
+
+    msaaSamples = chooseSampleCount(physicalDevice, options.samples);
+    std::cerr << "MSAA: " << msaaSamples << " samples (" << options.samples << " requested)" << std::endl;
     createDescriptorSetLayout(); //#
-    createGraphicsPipeline();
-
-    createFrameBuffer();
+    createPipelineLayout();
+    createPipelineCache();
+    createRenderTargets();
     createVertexBuffer();
     createIndexBuffer();
     createUniformBuffers();
+    createInstanceBuffers();
+    createBladePool();
+    createWindField();
+    createSimulation();
     createSyncObjects();
+    createQueryPool();
     createTexture();
+    createVertexAnimation();
 
-    createDescriptorPool(); //#
     createDescriptorSets(); //#
 
     createCommandPool();
     createCommandBuffers();
 
     copyVertices2GPU();
+    createCapture();
+
+    if (options.shaderReload)
+        shaderWatcher.reset(new ShaderWatcher("../shaders"));
 }
 
 void VulkanApp::Run()
 {
     currentFrame = 0;
+    if (options.benchmark) {
+        runBenchmark();
+        return;
+    }
+
+    auto lastTime = std::chrono::high_resolution_clock::now();
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
+        auto now = std::chrono::high_resolution_clock::now();
+        updateCamera(std::chrono::duration<float>(now - lastTime).count());
+        lastTime = now;
+        pollShaderReload();
         drawFrame();
     }
 
@@ -107,29 +167,66 @@ void VulkanApp::initResources()
 {
 
     nFrame = 0;
-    std::ifstream vertFile("../resource/vertex3.txt");
-    if (!vertFile.is_open())
-        RUN_TIME_ERROR("error loading configured vertices");
-
-    while (!vertFile.eof()) {
-        float vert;
-        vertFile >> vert;
-        vertices.push_back(vert); 
+    if (!options.archivePath.empty() && std::ifstream(options.archivePath).good()) {
+        archive.reset(new AssetArchive(options.archivePath));
+        std::cerr << "Archive: " << options.archivePath << ", " << archive->size() << " assets in " 
+                  << archive->bytes() << " bytes" << std::endl;
     }
 
-    vertFile.close();
-
-    std::ifstream idxFile("../resource/index3.txt");
-    if (!idxFile.is_open())
-        RUN_TIME_ERROR("error loading configured vert indexes");
-
-    while (!idxFile.eof()) {
-        uint16_t idx;
-        idxFile >> idx;
-        vertIdxs.push_back(idx); 
+    const AssetSpan* bakedVertices = archive ? archive->find(assets.path(config.vertices)) : nullptr;
+    const AssetSpan* bakedIndices  = archive ? archive->find(assets.path(config.indices)) : nullptr;
+    if (bakedVertices && bakedVertices->kind == AssetKind::Floats && bakedIndices && bakedIndices->kind == AssetKind::Indices16) {
+        vertices.assign(bakedVertices->as<float>(), bakedVertices->as<float>() + bakedVertices->count<float>());
+        vertIdxs.assign(bakedIndices->as<uint16_t>(), bakedIndices->as<uint16_t>() + bakedIndices->count<uint16_t>());
+    } else {
+        NumberReadStats vertexStats, indexStats;
+        readNumbers(jobs, assets.path(config.vertices), vertices, &vertexStats);
+        readNumbers(jobs, assets.path(config.indices), vertIdxs, &indexStats);
+        for (const NumberReadStats& stats : { vertexStats, indexStats })
+            std::cerr << "Resources: " << stats.values << " values, " << stats.bytes << " bytes in " << stats.chunks 
+                      << " chunks, " << stats.megabytesPerSecond() << " MB/s" << std::endl;
     }
-    idxFile.close();
-
+    if (vertices.size() % VERTEX_FLOATS != 0 || vertIdxs.size() % 3 != 0)
+        RUN_TIME_ERROR("initResources: partial vertex or triangle in the resource files");
+    std::cerr << "Scene: " << (options.scenePath.empty() ? "built-in" : options.scenePath) << ", " 
+              << config.species.size() << " species, " << framesInFlight << " frames in flight" << std::endl;
+    assets.report(std::cerr);
+
+    // the first 4 vertices / 2 triangles are the ground quad, the rest is the full res blade
+    groundRange = {0, 6, 0, 4};
+    // ground.vert scales unit corners to the field, the file stores +-2 with the uv at -1
+    const float groundCorners[4][2] = { {-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f} };
+    for (uint32_t i = 0; i < groundRange.vertexCount; i++) {
+        vertices[i * VERTEX_FLOATS + 0] = groundCorners[i][0];
+        vertices[i * VERTEX_FLOATS + 1] = groundCorners[i][1];
+        vertices[i * VERTEX_FLOATS + 2] = 0.0f;
+        vertices[i * VERTEX_FLOATS + 3] = 0.0f;
+    }
+    MeshRange blade;
+    blade.firstIndex   = groundRange.indexCount;
+    blade.indexCount   = uint32_t(vertIdxs.size()) - groundRange.indexCount;
+    blade.vertexOffset = int32_t(groundRange.vertexCount);
+    blade.vertexCount  = uint32_t(vertices.size() / VERTEX_FLOATS) - groundRange.vertexCount;
+    for (uint32_t i = blade.firstIndex; i < blade.firstIndex + blade.indexCount; i++)
+        vertIdxs[i] -= uint16_t(blade.vertexOffset);
+
+    bladeLods.build(blade, config.lod, vertices, vertIdxs);
+    // index3.txt is emitted row by row, reorder every lod for the post-transform cache
+    for (size_t lod = 0; lod < bladeLods.levelCount(); lod++)
+        optimizeMeshRange(bladeLods.level(lod).range, vertices, vertIdxs, grassField.bladesPerChunk(), std::cerr);
+    // the vertices are final, the flutter bakes while the device comes up and is waited for in createVertexAnimation
+    jobs.run([this]() { vertexAnimation.bake(jobs, vertices, config.constants); }, &vertexAnimationBake);
+
+    cameraTarget = glm::vec3(config.camera.target[0], config.camera.target[1], config.camera.target[2]);
+    frameIndex = 0;
+    depthPrepass = true;
+    prepassKeyDown = false;
+    sceneConstants = config.constants;
+    gust = false;
+    gustKeyDown = false;
+    pipelineHits = 0;
+    pipelineMisses = 0;
+    lastReport = std::chrono::high_resolution_clock::now();
 }
 
 void VulkanApp::createInstance()
@@ -151,10 +248,14 @@ void VulkanApp::createInstance()
 
     }
 
-    if (!foundLayer)
-      RUN_TIME_ERROR("Layer VK_LAYER_LUNARG_standard_validation not supported\n");
+    // headless runs are for test machines, which often have a driver but no SDK
+    if (foundLayer)
+        enabledLayers.push_back(g_validationLayerData);
+    else if (options.headless)
+        std::cerr << "Validation: no validation layer, running without" << std::endl;
+    else
+        RUN_TIME_ERROR("Layer VK_LAYER_LUNARG_standard_validation not supported\n");
 
-    enabledLayers.push_back(g_validationLayerData); 
     uint32_t extensionCount;
 
     vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
@@ -175,11 +276,21 @@ void VulkanApp::createInstance()
 
     
     std::vector<const char*> instanceExtensions;
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    instanceExtensions = std::vector<const char*>(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    if (!options.headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        instanceExtensions = std::vector<const char*>(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     instanceExtensions.push_back(g_debugReportExtName);
+    // needed to query the descriptor indexing features on a 1.0 instance
+    properties2Extension = false;
+    for (VkExtensionProperties prop : extensionProperties) {
+        if (strcmp(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, prop.extensionName) == 0) {
+            instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            properties2Extension = true;
+        }
+    }
 
     
     VkApplicationInfo appInfo = {};
@@ -257,8 +368,43 @@ void VulkanApp::getQueueFamily()
     } if (queueFamilyIdx == -1)
         RUN_TIME_ERROR("There is no families supporting requirements\n");
 
+    // a transfer only family is usually a copy engine that runs alongside graphics
+    transferFamilyIdx = queueFamilyIdx;
+    for (uint32_t i = 0; i < queueFamPoperties.size(); i++) {
+        VkQueueFlags flags = queueFamPoperties[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            transferFamilyIdx = i;
+            break;
+        }
+    }
+    dedicatedTransfer = transferFamilyIdx != queueFamilyIdx;
+    std::cerr << "Transfer: " << (dedicatedTransfer ? "dedicated family " : "shared with graphics, family ") 
+              << transferFamilyIdx << std::endl;
+
+    // a compute family without graphics runs the simulation next to the frame being rendered
+    computeFamilyIdx = (queueFamPoperties[queueFamilyIdx].queueFlags & VK_QUEUE_COMPUTE_BIT) ? queueFamilyIdx : UINT32_MAX;
+    for (uint32_t i = 0; i < queueFamPoperties.size() && options.asyncCompute; i++) {
+        VkQueueFlags flags = queueFamPoperties[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            computeFamilyIdx = i;
+            break;
+        }
+    }
+    bladeSimulation = computeFamilyIdx != UINT32_MAX;
+    asyncCompute = bladeSimulation && computeFamilyIdx != queueFamilyIdx;
+    if (!bladeSimulation)
+        std::cerr << "Compute: no compute support next to graphics, blade simulation disabled" << std::endl;
+    else
+        std::cerr << "Compute: " << (asyncCompute ? "async on family " : "inline on graphics family ") << computeFamilyIdx << std::endl;
+
+    // timestamps on both queues to measure how much of the simulation hides behind rendering
+    timestamps = queueFamPoperties[queueFamilyIdx].timestampValidBits > 0 &&
+                 (!bladeSimulation || queueFamPoperties[computeFamilyIdx].timestampValidBits > 0);
+
     //// check if chosen famili idx support surface 
     VkBool32 presentSupport = false;
+    if (options.headless)
+        return;
     vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIdx, surface, &presentSupport);
     if (!presentSupport)
       throw std::runtime_error("vkGetPhysicalDeviceSurfaceSupportKHR: no present support for the target device and graphics queue");
@@ -275,17 +421,71 @@ void VulkanApp::createDevice()
     float queuePriorities = 1.0;
     queueCreateInfo.pQueuePriorities = &queuePriorities;
 
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = { queueCreateInfo };
+    if (dedicatedTransfer) {
+        queueCreateInfo.queueFamilyIndex = transferFamilyIdx;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+    if (asyncCompute) {
+        queueCreateInfo.queueFamilyIndex = computeFamilyIdx;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    pipelineStatistics = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+
+    // the shaders pick their texture from the global array by a draw uniform index (textures[] in
+    // fragment.frag, depth.frag and the vertex animation variant of vertex.vert)
+    if (!supportedFeatures.shaderSampledImageArrayDynamicIndexing)
+        RUN_TIME_ERROR("createDevice: shaderSampledImageArrayDynamicIndexing is not supported, the texture array can't be indexed");
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+    // descriptor indexing lets the global texture array be partially bound and updated after bind
+    std::vector<const char*> deviceExtensions = DEVICE_EXTENTIONS;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    descriptorIndexing = false;
+    if (properties2Extension && deviceExtensionSupported(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+        deviceExtensionSupported(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        if (getFeatures2 != nullptr)
+            getFeatures2(physicalDevice, &features2);
+        descriptorIndexing = indexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+                             indexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexing{};
+    enabledIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    enabledIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+    enabledIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    if (descriptorIndexing) {
+        deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
+    // per heap budget and usage of the whole process, including what the driver allocates for us
+    memoryBudget = properties2Extension && deviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudget)
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    viewUsage = deviceExtensionSupported(physicalDevice, VK_KHR_MAINTENANCE2_EXTENSION_NAME);
+    if (viewUsage)
+        deviceExtensions.push_back(VK_KHR_MAINTENANCE2_EXTENSION_NAME);
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.pNext = nullptr;
+    createInfo.pNext = descriptorIndexing ? &enabledIndexing : nullptr;
     createInfo.flags = 0;
-    createInfo.pQueueCreateInfos = &queueCreateInfo;  
-    createInfo.queueCreateInfoCount = 1;
-    createInfo.enabledExtensionCount   = uint32_t(DEVICE_EXTENTIONS.size());
-    createInfo.ppEnabledExtensionNames = DEVICE_EXTENTIONS.data();
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    createInfo.queueCreateInfoCount = uint32_t(queueCreateInfos.size());
+    createInfo.enabledExtensionCount   = uint32_t(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
     createInfo.enabledLayerCount = uint32_t(enabledLayers.size());
     createInfo.ppEnabledLayerNames = enabledLayers.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -296,6 +496,19 @@ void VulkanApp::createDevice()
 
     vkGetDeviceQueue(device, queueFamilyIdx, 0, &graphicsQueue);
     vkGetDeviceQueue(device, queueFamilyIdx, 0, &presentQueue);
+    vkGetDeviceQueue(device, transferFamilyIdx, 0, &transferQueue);
+    computeQueue = VK_NULL_HANDLE;
+    if (bladeSimulation)
+        vkGetDeviceQueue(device, computeFamilyIdx, 0, &computeQueue);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    auto getMemoryProperties2 = properties2Extension ? 
+        (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR") : nullptr;
+    memoryTracker.init(physicalDevice, getMemoryProperties2, memoryBudget);
+    std::cerr << "Memory: " << (memoryTracker.budgetSupported() ? "VK_EXT_memory_budget" : "estimated") << " budgets" << std::endl;
 
 }
 
@@ -303,7 +516,7 @@ void VulkanApp::createWindow()
 {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+    window = glfwCreateWindow(int(config.window.width), int(config.window.height), "Vulkan", nullptr, nullptr);
 
     if (glfwVulkanSupported() != GLFW_TRUE) 
         RUN_TIME_ERROR("Error glfw do not support vulkan");
@@ -340,7 +553,7 @@ void VulkanApp::createSwapchain()
     }
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(formats);
-    VkExtent2D extent = chooseSwapExtent(surfaceCapabilities, WIDTH, HEIGHT);
+    VkExtent2D extent = chooseSwapExtent(surfaceCapabilities, int(config.window.width), int(config.window.height));
     VkSwapchainCreateInfoKHR createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.pNext = nullptr;
@@ -351,10 +564,16 @@ void VulkanApp::createSwapchain()
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (!options.capturePath.empty()) {
+        // frames are copied out of the swapchain image before it is presented
+        if (!(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+            RUN_TIME_ERROR("createSwapchain: the surface can't be copied from, frame capture is not supported");
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createInfo.preTransform = surfaceCapabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = chooseSwapPresentMode(presentModes);
+    createInfo.presentMode = chooseSwapPresentMode(presentModes, config.window.presentMode);
     createInfo.clipped = VK_TRUE;
     createInfo.oldSwapchain = VK_NULL_HANDLE;
 
@@ -397,39 +616,119 @@ void VulkanApp::createScreenImageViews()
 
 }
 
+void VulkanApp::createOffscreenTargets()
+{
+    // the format the swapchain prefers, so headless frames match what the window shows
+    screenBufferResources.swapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    screenBufferResources.swapChainExtent = { config.window.width, config.window.height };
+    screenBufferResources.swapChainImages.resize(framesInFlight);
+    offscreenMemory.resize(framesInFlight);
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = screenBufferResources.swapChainExtent.width;
+        imageInfo.extent.height = screenBufferResources.swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = screenBufferResources.swapChainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkImage& image = screenBufferResources.swapChainImages[i];
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+            RUN_TIME_ERROR("createOffscreenTargets: failed to create offscreen image!");
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+        offscreenMemory[i] = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Attachment);
+        vkBindImageMemory(device, image, offscreenMemory[i], 0);
+    }
+    std::cerr << "Headless: " << framesInFlight << " offscreen images of " << config.window.width << "x" 
+              << config.window.height << std::endl;
+
+    createScreenImageViews();
+}
+
 void VulkanApp::createRenderPass()
   {
+    // a multisampled color target is resolved into the swapchain image at the end of the subpass
+    bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    // headless frames are copied out instead of presented
+    VkImageLayout screenLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format         = screenBufferResources.swapChainImageFormat;
-    colorAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.samples        = msaaSamples;
     colorAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.storeOp        = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout    = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : screenLayout;
+
+    depthFormat = chooseDepthFormat(physicalDevice);
+
+    VkAttachmentDescription depthAttachment = {};
+    depthAttachment.format         = depthFormat;
+    depthAttachment.samples        = msaaSamples;
+    depthAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription resolveAttachment = {};
+    resolveAttachment.format         = screenBufferResources.swapChainImageFormat;
+    resolveAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+    resolveAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+    resolveAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    resolveAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+    resolveAttachment.finalLayout    = screenLayout;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    VkSubpassDescription subpass  = {};
-    subpass.pipelineBindPoint     = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount  = 1;
-    subpass.pColorAttachments     = &colorAttachmentRef;
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference resolveAttachmentRef = {};
+    resolveAttachmentRef.attachment = 2;
+    resolveAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkSubpassDescription subpass    = {};
+    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount    = 1;
+    subpass.pColorAttachments       = &colorAttachmentRef;
+    subpass.pResolveAttachments     = resolve ? &resolveAttachmentRef : nullptr;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    // the depth image is shared by the frames in flight, so the clear waits for the previous frame's depth writes
     VkSubpassDependency dependency = {};
     dependency.srcSubpass    = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass    = 0;
-    dependency.srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | 
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment, resolveAttachment };
 
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments    = &colorAttachment;
+    renderPassInfo.attachmentCount = resolve ? 3 : 2;
+    renderPassInfo.pAttachments    = attachments;
     renderPassInfo.subpassCount    = 1;
     renderPassInfo.pSubpasses      = &subpass;
     renderPassInfo.dependencyCount = 1;
@@ -439,46 +738,255 @@ void VulkanApp::createRenderPass()
         RUN_TIME_ERROR("CreateRenderPass: failed to create render pass!");
   }
 
+void VulkanApp::createRenderTargets()
+{
+    createRenderPass();
+    createGraphicsPipeline();
+
+    // depth and the multisampled color only live inside the render pass
+    createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 
+                     depthImage, depthImageMemory, depthImageView);
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+        createAttachment(screenBufferResources.swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+                         colorImage, colorImageMemory, colorImageView);
+    createFrameBuffer();
+}
+
+void VulkanApp::retireRenderTargets()
+{
+    // frames in flight may still render into these, the new targets are created next to them
+    cancelPipelineReload();
+    for (auto framebuffer : screenBufferResources.swapChainFramebuffers)
+        deletionQueue.retire(frameIndex, UniqueFramebuffer(device, framebuffer));
+    screenBufferResources.swapChainFramebuffers.clear();
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        deletionQueue.retire(frameIndex, UniqueImageView(device, colorImageView));
+        deletionQueue.retire(frameIndex, UniqueImage(device, colorImage));
+        memoryTracker.release(colorImageMemory);
+        deletionQueue.retire(frameIndex, UniqueMemory(device, colorImageMemory));
+    }
+    deletionQueue.retire(frameIndex, UniqueImageView(device, depthImageView));
+    deletionQueue.retire(frameIndex, UniqueImage(device, depthImage));
+    memoryTracker.release(depthImageMemory);
+    deletionQueue.retire(frameIndex, UniqueMemory(device, depthImageMemory));
+
+    // every variant was built against this render pass
+    for (auto& variant : pipelineVariants)
+        deletionQueue.retire(frameIndex, UniquePipeline(device, variant.second.pipeline));
+    pipelineVariants.clear();
+    deletionQueue.retire(frameIndex, UniqueRenderPass(device, renderPass));
+}
+
+void VulkanApp::setSampleCount(VkSampleCountFlagBits samples)
+{
+    retireRenderTargets();
+    msaaSamples = samples;
+    createRenderTargets();
+}
+
+void VulkanApp::createPipelineLayout()
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    pipelineLayoutInfo.setLayoutCount = uint32_t(descriptors.layouts().size());
+    pipelineLayoutInfo.pSetLayouts = descriptors.layouts().data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        RUN_TIME_ERROR("createPipelineLayout: failed to create pipeline layout!");
+}
+
 void VulkanApp::createGraphicsPipeline()
 {
-    ////load shader modules
-    std::vector<uint32_t> vertShaderCode;
-    std::vector<uint32_t> fragShaderCode;
-    loadShaderModule("../shaders/vert.spv", vertShaderCode);
-    loadShaderModule("../shaders/frag.spv", fragShaderCode);
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);   
+    // the ground only reads the position, all pipelines share the descriptor set
+    VertexLayout groundLayout = meshLayout;
+    groundLayout.attributes.resize(1);
+    std::vector<VertexLayout> grassLayouts = {meshLayout, instanceLayout};
+
+    // a gust is just another set of constants, the calm variants stay cached
+    SceneConstants scene = sceneConstants;
+    if (gust) {
+        scene.windPeriod    *= 0.5f;
+        scene.windAmplitude *= 2.0f;
+    }
+    std::vector<float> constants = scene.values();
+
+    // with multisampling the blade cutout comes from alpha to coverage instead of discard,
+    // the equal depth color pass inherits the coverage from the prepass depth samples
+    bool coverage = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    const char* groundVert = "../shaders/ground.vert.spv";
+    const char* groundFrag = "../shaders/ground.frag.spv";
+    const char* grassVert  = "../shaders/vert.spv";
+    const char* grassBaked = "../shaders/vert_vat.spv";
+    const char* grassFrag  = coverage ? "../shaders/frag_nodiscard.spv" : "../shaders/frag.spv";
+    const char* grassDepth = coverage ? "../shaders/depth_nodiscard.spv" : "../shaders/depth.frag.spv";
+    groundPipeline      = getPipeline({groundVert, groundFrag, {groundLayout}, VK_COMPARE_OP_LESS,  true,  true,  false,    constants});
+    grassPipeline       = getPipeline({grassVert,  grassFrag,  grassLayouts,   VK_COMPARE_OP_LESS,  true,  true,  coverage, constants});
+    groundDepthPipeline = getPipeline({groundVert, nullptr,    {groundLayout}, VK_COMPARE_OP_LESS,  true,  false, false,    constants});
+    grassDepthPipeline  = getPipeline({grassVert,  grassDepth, grassLayouts,   VK_COMPARE_OP_LESS,  true,  false, coverage, constants});
+    groundEqualPipeline = getPipeline({groundVert, groundFrag, {groundLayout}, VK_COMPARE_OP_EQUAL, false, true,  false,    constants});
+    grassEqualPipeline  = getPipeline({grassVert,  "../shaders/frag_nodiscard.spv", grassLayouts, VK_COMPARE_OP_EQUAL, false, true, false, constants});
+    grassBakedPipeline      = getPipeline({grassBaked, grassFrag,  grassLayouts, VK_COMPARE_OP_LESS,  true,  true,  coverage, constants});
+    grassBakedDepthPipeline = getPipeline({grassBaked, grassDepth, grassLayouts, VK_COMPARE_OP_LESS,  true,  false, coverage, constants});
+    grassBakedEqualPipeline = getPipeline({grassBaked, "../shaders/frag_nodiscard.spv", grassLayouts, VK_COMPARE_OP_EQUAL, false, true, false, constants});
+}
+
+VkPipeline VulkanApp::getPipeline(const PipelineDesc& desc)
+{
+    std::string key = pipelineKey(desc);
+    auto it = pipelineVariants.find(key);
+    if (it != pipelineVariants.end()) {
+        pipelineHits++;
+        return it->second.pipeline;
+    }
+    pipelineMisses++;
+    VkPipeline pipeline = createPipeline(desc);
+    pipelineVariants[key] = { desc, pipeline };
+    return pipeline;
+}
+
+void VulkanApp::createPipelineCache()
+{
+    // a cache from an older driver or another device is rejected by the driver itself
+    std::vector<char> data;
+    std::ifstream file("pipeline_cache.bin", std::ios::binary);
+    if (file.is_open())
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        RUN_TIME_ERROR("createPipelineCache: failed to create pipeline cache!");
+}
+
+void VulkanApp::destroyPipelineCache()
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) == VK_SUCCESS && size > 0) {
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) == VK_SUCCESS) {
+            std::ofstream file("pipeline_cache.bin", std::ios::binary);
+            file.write(data.data(), std::streamsize(size));
+        }
+    }
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+void VulkanApp::pollShaderReload()
+{
+    if (!shaderWatcher)
+        return;
+    std::vector<std::string> rebuilt = shaderWatcher->takeRebuilt();
+    reloadPending.insert(reloadPending.end(), rebuilt.begin(), rebuilt.end());
+
+    if (pipelineReload.valid()) {
+        if (pipelineReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        // between frames: the next command buffer records the new pipelines, the frames
+        // in flight keep the old ones until they have finished
+        std::vector<std::pair<std::string, VkPipeline>> swapped = pipelineReload.get();
+        for (auto& entry : swapped) {
+            PipelineVariant& variant = pipelineVariants[entry.first];
+            deletionQueue.retire(frameIndex, UniquePipeline(device, variant.pipeline));
+            variant.pipeline = entry.second;
+        }
+        createGraphicsPipeline();
+        std::cerr << "Shader reload: swapped " << swapped.size() << " pipelines" << std::endl;
+    }
+    if (reloadPending.empty())
+        return;
+
+    std::vector<std::pair<std::string, PipelineDesc>> affected;
+    for (auto& variant : pipelineVariants) {
+        const PipelineDesc& desc = variant.second.desc;
+        for (const std::string& binary : reloadPending) {
+            if (binary == desc.vertShader || (desc.fragShader != nullptr && binary == desc.fragShader)) {
+                affected.push_back({ variant.first, desc });
+                break;
+            }
+        }
+    }
+    reloadPending.clear();
+    if (affected.empty())
+        return;
+
+    // render pass, layout and cache stay alive while a reload is running, see cancelPipelineReload
+    pipelineReload = std::async(std::launch::async, [this, affected]() {
+        std::vector<std::pair<std::string, VkPipeline>> result;
+        for (const auto& entry : affected) {
+            try {
+                result.push_back({ entry.first, createPipeline(entry.second) });
+            } catch (const std::exception& e) {
+                std::cerr << "Shader reload: " << e.what();
+            }
+        }
+        return result;
+    });
+}
+
+void VulkanApp::cancelPipelineReload()
+{
+    if (!pipelineReload.valid())
+        return;
+    for (auto& entry : pipelineReload.get())
+        vkDestroyPipeline(device, entry.second, nullptr);
+}
+
+VkPipeline VulkanApp::createPipeline(const PipelineDesc& desc)
+{
+    ////load shader modules, destroyed on return or when a reload fails to build the pipeline
+    UniqueShaderModule vertShaderModule(device, loadShader(desc.vertShader));
+    UniqueShaderModule fragShaderModule;
+    if (desc.fragShader != nullptr)
+        fragShaderModule.reset(device, loadShader(desc.fragShader));
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.module = vertShaderModule.get();
     vertShaderStageInfo.pName = "main";
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.module = fragShaderModule.get();
     fragShaderStageInfo.pName = "main";
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    // one entry per constant, ids a stage does not declare are ignored
+    std::vector<VkSpecializationMapEntry> mapEntries(desc.constants.size());
+    for (uint32_t i = 0; i < mapEntries.size(); i++)
+        mapEntries[i] = { i, uint32_t(i * sizeof(float)), sizeof(float) };
 
-    VkVertexInputBindingDescription inputBinding = { };
-    inputBinding.binding = 0;
-    inputBinding.stride = sizeof(float) * 4;
-    inputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = uint32_t(mapEntries.size());
+    specializationInfo.pMapEntries = mapEntries.data();
+    specializationInfo.dataSize = desc.constants.size() * sizeof(float);
+    specializationInfo.pData = desc.constants.data();
+    vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
-    VkVertexInputAttributeDescription attributes[] = {
-        {0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
-        {1, 0, VK_FORMAT_R32G32_SFLOAT, 2*sizeof(float)}
-    };
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    std::vector<VkVertexInputBindingDescription> inputBindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    describeVertexInput(desc.layouts, inputBindings, attributes);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = 2;
-    vertexInputInfo.pVertexBindingDescriptions = &inputBinding;
-    vertexInputInfo.pVertexAttributeDescriptions = attributes;
+    vertexInputInfo.vertexBindingDescriptionCount = uint32_t(inputBindings.size());
+    vertexInputInfo.vertexAttributeDescriptionCount = uint32_t(attributes.size());
+    vertexInputInfo.pVertexBindingDescriptions = inputBindings.data();
+    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
     
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
     inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -489,8 +997,8 @@ void VulkanApp::createGraphicsPipeline()
     VkViewport viewport = {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float)WIDTH;
-    viewport.height = (float)HEIGHT;
+    viewport.width = (float)screenBufferResources.swapChainExtent.width;
+    viewport.height = (float)screenBufferResources.swapChainExtent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
@@ -520,11 +1028,13 @@ void VulkanApp::createGraphicsPipeline()
     VkPipelineMultisampleStateCreateInfo multisampling = {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = msaaSamples;
+    multisampling.alphaToCoverageEnable = desc.alphaToCoverage ? VK_TRUE : VK_FALSE;
 
     //ColorBlend
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.colorWriteMask = desc.colorWrite ? 
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
     colorBlendAttachment.blendEnable = VK_FALSE;
 
     VkPipelineColorBlendStateCreateInfo colorBlending = {};
@@ -537,22 +1047,19 @@ void VulkanApp::createGraphicsPipeline()
     colorBlending.blendConstants[1] = 0.0f;
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
-    
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    //pipelineLayoutInfo.setLayoutCount = 0;
-    //pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depthCompare;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
 
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-        RUN_TIME_ERROR("createGraphicsPipeline: failed to create pipeline layout!");
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = desc.fragShader != nullptr ? 2 : 1;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
@@ -560,16 +1067,16 @@ void VulkanApp::createGraphicsPipeline()
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.layout = pipelineLayout;
     pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
-        RUN_TIME_ERROR("createGraphicsPipeline: failed to create graphics pipeline!");
-
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        RUN_TIME_ERROR("createPipeline: failed to create graphics pipeline!");
+    return pipeline;
 }
 
 void VulkanApp::createFrameBuffer()
@@ -577,13 +1084,17 @@ void VulkanApp::createFrameBuffer()
     screenBufferResources.swapChainFramebuffers.resize(screenBufferResources.swapChainImageViews.size());
 
     for (size_t i = 0; i < screenBufferResources.swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = { screenBufferResources.swapChainImageViews[i] };
+        std::vector<VkImageView> attachments;
+        if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+            attachments = { colorImageView, depthImageView, screenBufferResources.swapChainImageViews[i] };
+        else
+            attachments = { screenBufferResources.swapChainImageViews[i], depthImageView };
 
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.attachmentCount = uint32_t(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
         framebufferInfo.width = screenBufferResources.swapChainExtent.width;
         framebufferInfo.height = screenBufferResources.swapChainExtent.height;
         framebufferInfo.layers = 1;
@@ -593,236 +1104,1001 @@ void VulkanApp::createFrameBuffer()
     }
 }
 
-void VulkanApp::createVertexBuffer()
+void VulkanApp::createAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                                 VkImage& image, VkDeviceMemory& memory, VkImageView& view)
 {
-    VkBufferCreateInfo bufferCreateInfo = {};
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.pNext = nullptr;
-    bufferCreateInfo.size = vertices.size() * sizeof(float);                         
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;            
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = screenBufferResources.swapChainExtent.width;
+    imageInfo.extent.height = screenBufferResources.swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = msaaSamples;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+        RUN_TIME_ERROR("createAttachment: failed to create attachment image!");
 
-    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, &vertexBuffer) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error creating vertex buffer");
-    
     VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(device, vertexBuffer, &memoryRequirements);
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
-    uint32_t memoryTypeIndex = -1;
+    // tilers can keep transient attachments on chip when lazily allocated memory is offered
     VkPhysicalDeviceMemoryProperties memoryProperties;
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-    {
-        if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-            ((memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
-                memoryTypeIndex = i;
-                break;
-            }
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    lazyAttachments = false;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((memoryRequirements.memoryTypeBits & (1 << i)) && 
+            (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+            lazyAttachments = true;
+            break;
+        }
     }
 
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = memoryTypeIndex;
-
-    if (vkAllocateMemory(device, &allocateInfo, nullptr, &vertexMemory) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error allocating vertex memmory");
-  
-
-    if (vkBindBufferMemory(device, vertexBuffer, vertexMemory, 0) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error binding vertex memmory");
-  
+    memory = allocateMemory(memoryRequirements, properties, MemoryCategory::Attachment);
+    vkBindImageMemory(device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspect;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+        RUN_TIME_ERROR("createAttachment: failed to create attachment image view!");
 }
 
-void VulkanApp::createIndexBuffer()
+void VulkanApp::runBenchmark()
 {
-    VkBufferCreateInfo bufferCreateInfo = {};
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.pNext = nullptr;
-    bufferCreateInfo.size = vertIdxs.size() * sizeof(uint16_t);                         
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;            
-
-    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, &idxBuffer) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error creating index buffer");
-    
-    VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(device, idxBuffer, &memoryRequirements);
+    const uint32_t warmupFrames = 60;
+    const uint32_t frames       = 300;
+    const double   MB           = 1024.0 * 1024.0;
+    const double   GB           = 1024.0 * MB;
+
+    double pixels = double(screenBufferResources.swapChainExtent.width) * screenBufferResources.swapChainExtent.height;
+    uint32_t colorBytes = 4;
+    uint32_t depthBytes = depthFormat == VK_FORMAT_D16_UNORM ? 2 : (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ? 8 : 4);
+
+    std::cerr << "Benchmark: " << frames << " frames per sample count, depth prepass " << (depthPrepass ? "on" : "off") << std::endl;
+    VkSampleCountFlags supported = supportedSampleCounts(physicalDevice);
+    for (uint32_t samples = VK_SAMPLE_COUNT_1_BIT; samples <= VK_SAMPLE_COUNT_8_BIT; samples <<= 1) {
+        if (!(supported & samples) || glfwWindowShouldClose(window))
+            continue;
+        setSampleCount(VkSampleCountFlagBits(samples));
+
+        for (uint32_t i = 0; i < warmupFrames; i++) {
+            glfwPollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
 
-    uint32_t memoryTypeIndex = -1;
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-    {
-        if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-            ((memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
-                memoryTypeIndex = i;
-                break;
-            }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < frames; i++) {
+            glfwPollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+
+        // lower bound on attachment traffic: every sample is written once, the resolve reads
+        // the color samples and writes the swapchain image
+        double attachmentBytes = pixels * samples * (colorBytes + depthBytes);
+        double traffic = attachmentBytes + (samples > 1 ? pixels * (samples * colorBytes + colorBytes) : 0.0);
+        std::cerr << "  " << samples << "x: " << ms << " ms/frame, attachments " << attachmentBytes / MB << " MB" 
+                  << (lazyAttachments && samples > 1 ? " (lazily allocated)" : "") << ", traffic >= " 
+                  << traffic / MB << " MB/frame, " << traffic / GB / (ms / 1000.0) << " GB/s" << std::endl;
     }
-
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = memoryTypeIndex;
-
-    if (vkAllocateMemory(device, &allocateInfo, nullptr, &idxMemory) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error allocating idx memmory");
-  
-
-    if (vkBindBufferMemory(device, idxBuffer, idxMemory, 0) != VK_SUCCESS)
-        RUN_TIME_ERROR("Error binding idx memmory");
-  
 }
 
-void VulkanApp::createUniformBuffers() 
+void VulkanApp::RenderOffscreen(uint32_t frames, OffscreenFrame& result)
 {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-    uniformBuffers.resize(screenBufferResources.swapChainImages.size());
-    uniformBuffersMemory.resize(screenBufferResources.swapChainImages.size());
-
-    for (size_t i = 0; i < screenBufferResources.swapChainImages.size(); i++) {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = bufferSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &uniformBuffers[i]) != VK_SUCCESS) 
-            RUN_TIME_ERROR("failed to create uniform buffer!");
-    
-        VkMemoryRequirements memoryRequirements;
-        vkGetBufferMemoryRequirements(device, uniformBuffers[i], &memoryRequirements);
+    if (!options.headless)
+        RUN_TIME_ERROR("RenderOffscreen: the app was not created headless");
+    const uint32_t maxSettleFrames = 1000;
+    currentFrame = 0;
 
-        uint32_t prop = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        uint32_t memoryTypeIndex = -1;
-        VkPhysicalDeviceMemoryProperties memoryProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-        {
-            if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-                ((memoryProperties.memoryTypes[i].propertyFlags & prop) == prop)) {
-                    memoryTypeIndex = i;
-                    break;
-                }
-        }
+    // chunks are generated by jobs and arrive a few per frame, in an order that depends on thread timing
+    result.settleFrames = 0;
+    do {
+        drawFrame();
+        result.settleFrames++;
+    } while (!grassField.complete() && result.settleFrames < maxSettleFrames);
+    if (!grassField.complete())
+        RUN_TIME_ERROR("RenderOffscreen: the field did not finish streaming in");
+    vkDeviceWaitIdle(device);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memoryRequirements.size;
-        allocInfo.memoryTypeIndex = memoryTypeIndex;
+    // from here on nothing depends on when each chunk arrived: the blades start at rest, the lod
+    // selection has no history and the clock starts at zero
+    VkCommandBuffer commandBuffer = beginOneTimeCommands(commandPool);
+    vkCmdFillBuffer(commandBuffer, bladeStateBuffer, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(commandBuffer);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        RUN_TIME_ERROR("RenderOffscreen: failed to submit the state reset!");
+    vkQueueWaitIdle(graphicsQueue);
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    bladeLods.reset(0, grassField.bladeCapacity());
+    nFrame = 0;
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &uniformBuffersMemory[i]) != VK_SUCCESS) 
-            RUN_TIME_ERROR("failed to allocate uniform buffer memory!");
+    // only the measured frames count
+    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+        readStatistics(frame);
+        readTimestamps(frame);
+    }
+    prepassInvocations = colorInvocations = 0;
+    statisticsFrames = 0;
+    simulationMs = graphicsMs = overlapMs = 0.0;
+    timedFrames = 0;
 
-        vkBindBufferMemory(device, uniformBuffers[i], uniformBuffersMemory[i], 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < frames; i++)
+        drawFrame();
+    vkDeviceWaitIdle(device);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+        readStatistics(frame);
+        readTimestamps(frame);
     }
+
+    result.cpuMsPerFrame = frames > 0 ? ms / frames : 0.0;
+    result.gpuMsPerFrame = timedFrames > 0 ? graphicsMs / timedFrames : 0.0;
+    result.fragmentInvocations = statisticsFrames > 0 ? double(prepassInvocations + colorInvocations) / statisticsFrames : 0.0;
+    size_t lastFrame = (currentFrame + framesInFlight - 1) % framesInFlight;
+    readBackImage(screenBufferResources.swapChainImages[lastFrame], result);
 }
 
-void VulkanApp::createSyncObjects()
+void VulkanApp::readBackImage(VkImage image, OffscreenFrame& result)
 {
-    syncObj.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    syncObj.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    syncObj.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    VkExtent2D extent = screenBufferResources.swapChainExtent;
+    VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+    VkBuffer readBuffer;
+    VkDeviceMemory readMemory;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 MemoryCategory::Staging, readBuffer, readMemory);
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands(commandPool);
+    // the render pass left the image in TRANSFER_SRC_OPTIMAL, its writes still have to reach the copy
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readBuffer, 1, &region);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &hostBarrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(commandBuffer);
 
-    VkSemaphoreCreateInfo semaphoreInfo = {};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        RUN_TIME_ERROR("readBackImage: failed to submit the copy!");
+    vkQueueWaitIdle(graphicsQueue);
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
-    {
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence    (device, &fenceInfo,     nullptr, &syncObj.inFlightFences[i]) != VK_SUCCESS) {
-            RUN_TIME_ERROR("createSyncObjects failed to create synchronization objects for a frame!");
-        }
+    void* data;
+    if (vkMapMemory(device, readMemory, 0, size, 0, &data) != VK_SUCCESS)
+        RUN_TIME_ERROR("readBackImage: failed to map the read back buffer!");
+    const uint8_t* bgra = static_cast<const uint8_t*>(data);
+    result.width  = extent.width;
+    result.height = extent.height;
+    result.rgb.resize(size_t(extent.width) * extent.height * 3);
+    for (size_t i = 0; i < size_t(extent.width) * extent.height; i++) {
+        result.rgb[3 * i + 0] = bgra[4 * i + 2];
+        result.rgb[3 * i + 1] = bgra[4 * i + 1];
+        result.rgb[3 * i + 2] = bgra[4 * i + 0];
     }
+    vkUnmapMemory(device, readMemory);
+    vkDestroyBuffer(device, readBuffer, nullptr);
+    freeMemory(readMemory);
 }
 
-void VulkanApp::createCommandPool()
+void VulkanApp::createCapture()
 {
-    VkCommandPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = queueFamilyIdx;
+    captureFrameSlots.assign(framesInFlight, -1);
+    captureCoherent = true;
+    if (options.capturePath.empty())
+        return;
+
+    VkFormat format = screenBufferResources.swapChainImageFormat;
+    bool bgr = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    if (!bgr && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+        RUN_TIME_ERROR("createCapture: frame capture needs an 8 bit RGBA or BGRA swapchain format");
+
+    // the cpu reads every byte, cached memory makes that much faster where the device has it
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    if (memoryTracker.findType(UINT32_MAX, properties) == UINT32_MAX)
+        properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    captureCoherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    // every frame in flight copies into one, as many again wait for the encoder before frames are dropped
+    VkExtent2D extent = screenBufferResources.swapChainExtent;
+    VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+    uint32_t slotCount = 2 * framesInFlight;
+    captureBuffers.resize(slotCount);
+    captureMemory.resize(slotCount);
+    std::vector<const uint8_t*> slots(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, MemoryCategory::Staging, captureBuffers[i], captureMemory[i]);
+        void* data;
+        if (vkMapMemory(device, captureMemory[i], 0, size, 0, &data) != VK_SUCCESS)
+            RUN_TIME_ERROR("createCapture: failed to map a capture buffer!");
+        slots[i] = static_cast<const uint8_t*>(data);
+    }
+    try {
+        capture.reset(new FrameCapture(options.capturePath, extent.width, extent.height, options.captureFps, bgr, slots));
+    } catch (const std::exception& error) {
+        RUN_TIME_ERROR(error.what());
+    }
+    std::cerr << "Capture: " << extent.width << "x" << extent.height << " to " << options.capturePath << ", " << slotCount
+              << " read back buffers of " << size / (1024 * 1024) << " MiB" << (captureCoherent ? "" : ", host cached") << std::endl;
+}
 
-    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
-        RUN_TIME_ERROR("createCommandPool failed to create command pool!");    
+void VulkanApp::finishCapture()
+{
+    if (!capture)
+        return;
+    // hand over what the frames still in flight copied, oldest first
+    vkDeviceWaitIdle(device);
+    for (size_t i = 0; i < framesInFlight; i++)
+        collectCapture(uint32_t((currentFrame + i) % framesInFlight));
+    capture.reset();
+    for (size_t i = 0; i < captureBuffers.size(); i++) {
+        vkUnmapMemory(device, captureMemory[i]);
+        vkDestroyBuffer(device, captureBuffers[i], nullptr);
+        freeMemory(captureMemory[i]);
+    }
+    captureBuffers.clear();
+    captureMemory.clear();
 }
 
-void VulkanApp::createCommandBuffers() 
+void VulkanApp::recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
-    commandBuffers.resize(screenBufferResources.swapChainFramebuffers.size());
+    if (!capture)
+        return;
+    int32_t slot = capture->acquire();
+    captureFrameSlots[currentFrame] = slot;
+    if (slot < 0)
+        return;
+
+    // the render pass leaves the image ready to present (or to copy, headless)
+    VkImageLayout screenLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkImage image = screenBufferResources.swapChainImages[imageIndex];
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = screenLayout;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkExtent2D extent = screenBufferResources.swapChainExtent;
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, captureBuffers[slot], 1, &region);
+
+    // back for present, the copy only read the image so nothing has to be made visible
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = screenLayout;
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         1, &hostBarrier, 0, nullptr, 1, &imageBarrier);
+}
 
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+void VulkanApp::collectCapture(uint32_t frame)
+{
+    if (!capture || captureFrameSlots[frame] < 0)
+        return;
+    // the frame's fence has been waited, its copy is complete
+    uint32_t slot = uint32_t(captureFrameSlots[frame]);
+    captureFrameSlots[frame] = -1;
+    if (!captureCoherent) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = captureMemory[slot];
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+    capture->queue(slot);
+}
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-        RUN_TIME_ERROR("createCommandBuffers: failed to allocate command buffers!");
+void VulkanApp::createQueryPool()
+{
+    statisticsPending.assign(framesInFlight, false);
+    prepassInvocations = 0;
+    colorInvocations   = 0;
+    statisticsFrames   = 0;
+
+    timestampsPending.assign(framesInFlight, false);
+    previousGraphics[0] = previousGraphics[1] = 0;
+    simulationMs = graphicsMs = overlapMs = 0.0;
+    timedFrames  = 0;
+    if (timestamps) {
+        // graphics begin/end, simulation begin/end per frame in flight
+        VkQueryPoolCreateInfo timestampInfo = {};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        timestampInfo.queryCount = 4 * framesInFlight;
+        if (vkCreateQueryPool(device, &timestampInfo, nullptr, &timestampPool) != VK_SUCCESS)
+            RUN_TIME_ERROR("createQueryPool: failed to create timestamp query pool!");
+    }
 
-    for (size_t i = 0; i < commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    if (!pipelineStatistics) {
+        std::cerr << "pipelineStatisticsQuery is not supported, overdraw will not be measured" << std::endl;
+        return;
+    }
 
-        if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) 
-            RUN_TIME_ERROR("createCommandBuffers: failed to begin recording command buffer!");
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = 2 * framesInFlight;
+    poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
 
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = screenBufferResources.swapChainFramebuffers[i];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = screenBufferResources.swapChainExtent;
+    if (vkCreateQueryPool(device, &poolInfo, nullptr, &statisticsPool) != VK_SUCCESS)
+        RUN_TIME_ERROR("createQueryPool: failed to create pipeline statistics query pool!");
+}
 
-        VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+void VulkanApp::readStatistics(uint32_t frame)
+{
+    if (!pipelineStatistics || !statisticsPending[frame])
+        return;
+    statisticsPending[frame] = false;
+
+    // the frame's fence has signaled, so both queries are available
+    uint64_t invocations[2];
+    if (vkGetQueryPoolResults(device, statisticsPool, 2 * frame, 2, sizeof(invocations), invocations, 
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+    prepassInvocations += invocations[0];
+    colorInvocations   += invocations[1];
+    statisticsFrames++;
+}
 
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+void VulkanApp::reportStatistics(std::ostream& out)
+{
+    if (!pipelineStatistics || statisticsFrames == 0)
+        return;
+
+    double pixels = double(screenBufferResources.swapChainExtent.width) * screenBufferResources.swapChainExtent.height;
+    double prepass = double(prepassInvocations) / statisticsFrames;
+    double color   = double(colorInvocations) / statisticsFrames;
+    out << "Depth: prepass " << (depthPrepass ? "on" : "off") << " (P toggles), FS invocations per frame "
+        << uint64_t(prepass) << " prepass, " << uint64_t(color) << " color, overdraw " 
+        << color / pixels << " color, " << (prepass + color) / pixels << " total" << std::endl;
+    prepassInvocations = 0;
+    colorInvocations   = 0;
+    statisticsFrames   = 0;
+}
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[]   = { 0 };
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffers[i], idxBuffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
-        //vkCmdDraw(commandBuffers[i], vertices.size(), 1, 0, 0);
-        vkCmdDrawIndexed(commandBuffers[i], vertIdxs.size(), 100, 0, 0, 0);
-        vkCmdEndRenderPass(commandBuffers[i]);
+void VulkanApp::readTimestamps(uint32_t frame)
+{
+    if (!timestamps || !timestampsPending[frame])
+        return;
+    timestampsPending[frame] = false;
+
+    uint64_t ticks[4] = {};
+    uint32_t count = bladeSimulation ? 4 : 2;
+    if (vkGetQueryPoolResults(device, timestampPool, 4 * frame, count, sizeof(ticks), ticks, 
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    double msPerTick = timestampPeriod * 1e-6;
+    graphicsMs += (ticks[1] - ticks[0]) * msPerTick;
+    if (bladeSimulation) {
+        simulationMs += (ticks[3] - ticks[2]) * msPerTick;
+        // the simulation of a frame is submitted while the previous frame renders
+        if (asyncCompute && previousGraphics[1] != 0) {
+            uint64_t begin = std::max(ticks[2], previousGraphics[0]);
+            uint64_t end   = std::min(ticks[3], previousGraphics[1]);
+            if (end > begin)
+                overlapMs += (end - begin) * msPerTick;
+        }
+    }
+    previousGraphics[0] = ticks[0];
+    previousGraphics[1] = ticks[1];
+    timedFrames++;
+}
 
-        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) 
-            RUN_TIME_ERROR("failed to record command buffer!");
-        
+void VulkanApp::reportTimestamps(std::ostream& out)
+{
+    if (!timestamps || timedFrames == 0)
+        return;
+
+    out << "GPU time per frame: graphics " << graphicsMs / timedFrames << " ms";
+    if (bladeSimulation) {
+        out << ", simulation " << simulationMs / timedFrames << " ms " << (asyncCompute ? "async" : "inline");
+        if (asyncCompute && simulationMs > 0.0)
+            out << ", " << uint32_t(100.0 * overlapMs / simulationMs) << "% overlapped with graphics";
     }
+    out << std::endl;
+    simulationMs = graphicsMs = overlapMs = 0.0;
+    timedFrames  = 0;
 }
 
-void VulkanApp::createTexture()
+void VulkanApp::createSimulation()
 {
-    grassTextureImage.image = stbi_load("../resource/grass-texture.png", &grassTextureImage.w, 
-                                                                         &grassTextureImage.h, 
-                                                                         &grassTextureImage.c, 
-                                                                         STBI_rgb_alpha);
-    VkDeviceSize imageSize = grassTextureImage.w * grassTextureImage.h * 4;
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    simulationSetLayout = VK_NULL_HANDLE;
+    simulationLayout    = VK_NULL_HANDLE;
+    simulationPipeline  = VK_NULL_HANDLE;
+    simulationPool      = VK_NULL_HANDLE;
+    if (!bladeSimulation)
+        return;
+
+    // blade pool, state read, state written, wind field of the frame (dynamic offset)
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &simulationSetLayout) != VK_SUCCESS)
+        RUN_TIME_ERROR("createSimulation: failed to create descriptor set layout!");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SimulationConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &simulationSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &simulationLayout) != VK_SUCCESS)
+        RUN_TIME_ERROR("createSimulation: failed to create pipeline layout!");
+
+    UniqueShaderModule shaderModule(device, loadShader("../shaders/simulate.comp.spv"));
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule.get();
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = simulationLayout;
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &simulationPipeline) != VK_SUCCESS)
+        RUN_TIME_ERROR("createSimulation: failed to create compute pipeline!");
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * uint32_t(simulationSets.size()) },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, uint32_t(simulationSets.size()) },
+    };
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = uint32_t(simulationSets.size());
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &simulationPool) != VK_SUCCESS)
+        RUN_TIME_ERROR("createSimulation: failed to create descriptor pool!");
+
+    std::array<VkDescriptorSetLayout, 2> setLayouts = { simulationSetLayout, simulationSetLayout };
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = simulationPool;
+    allocInfo.descriptorSetCount = uint32_t(setLayouts.size());
+    allocInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(device, &allocInfo, simulationSets.data()) != VK_SUCCESS)
+        RUN_TIME_ERROR("createSimulation: failed to allocate descriptor sets!");
+
+    // set h writes half h and reads the other one
+    VkDeviceSize stateRange = grassField.bladeCapacity() * sizeof(glm::vec2);
+    for (uint32_t half = 0; half < 2; half++) {
+        VkDescriptorBufferInfo bufferInfos[4] = {
+            { bladePoolBuffer, 0, VK_WHOLE_SIZE },
+            { bladeStateBuffer, (1 - half) * bladeStateStride, stateRange },
+            { bladeStateBuffer, half * bladeStateStride, stateRange },
+            { windBuffer, 0, WIND_FIELD_SIZE * WIND_FIELD_SIZE * sizeof(glm::vec2) },
+        };
+        VkWriteDescriptorSet writes[4] = {};
+        for (uint32_t i = 0; i < 4; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = simulationSets[half];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+    }
+}
+
+void VulkanApp::destroySimulation()
+{
+    vkDestroyDescriptorPool(device, simulationPool, nullptr);
+    vkDestroyPipeline(device, simulationPipeline, nullptr);
+    vkDestroyPipelineLayout(device, simulationLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, simulationSetLayout, nullptr);
+}
+
+void VulkanApp::packVertices()
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R16G16_UNORM, &formatProperties);
+    bool quantized = (formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+
+    meshLayout = meshVertexLayout(quantized);
+    instanceLayout = instanceVertexLayout();
+    fitBounds(meshLayout, vertices);
+    encodeVertices(meshLayout, vertices, vertexData);
+
+    std::cerr << "Vertex format: " << (quantized ? "R16G16_UNORM" : "R32G32_SFLOAT") << ", " 
+              << vertices.size() / VERTEX_FLOATS << " vertices, stride " << meshLayout.stride << " bytes, " 
+              << vertexData.size() << " bytes (" << vertices.size() * sizeof(float) << " unpacked)" << std::endl;
+}
+
+void VulkanApp::createVertexBuffer()
+{
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.size = vertexData.size();                         
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;            
+
+    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, &vertexBuffer) != VK_SUCCESS)
+        RUN_TIME_ERROR("Error creating vertex buffer");
+    
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, vertexBuffer, &memoryRequirements);
+
+    vertexMemory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Vertex);
+
+    if (vkBindBufferMemory(device, vertexBuffer, vertexMemory, 0) != VK_SUCCESS)
+        RUN_TIME_ERROR("Error binding vertex memmory");
+  
+}
+
+void VulkanApp::createIndexBuffer()
+{
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.size = vertIdxs.size() * sizeof(uint16_t);                         
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;            
+
+    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, &idxBuffer) != VK_SUCCESS)
+        RUN_TIME_ERROR("Error creating index buffer");
+    
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, idxBuffer, &memoryRequirements);
+
+    idxMemory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Index);
+
+    if (vkBindBufferMemory(device, idxBuffer, idxMemory, 0) != VK_SUCCESS)
+        RUN_TIME_ERROR("Error binding idx memmory");
+  
+}
+
+void VulkanApp::createUniformBuffers() 
+{
+    // dynamic offsets must be multiples of minUniformBufferOffsetAlignment
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    uniformStride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+
+    createBuffer(uniformStride * framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+                 MemoryCategory::Uniform, uniformBuffer, uniformBufferMemory);
+    void* data;
+    if (vkMapMemory(device, uniformBufferMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+        RUN_TIME_ERROR("createUniformBuffers: failed to map uniform buffer!");
+    uniformBufferMapped = (uint8_t*)data;
+}
+
+void VulkanApp::createInstanceBuffers()
+{
+    // every blade the field can keep resident
+    VkDeviceSize bufferSize = sizeof(uint32_t) * grassField.bladeCapacity();
+
+    instanceBuffers.resize(framesInFlight);
+    instanceBuffersMemory.resize(framesInFlight);
+    instanceBuffersMapped.resize(framesInFlight);
+
+    for (size_t i = 0; i < framesInFlight; i++) {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     MemoryCategory::Vertex, instanceBuffers[i], instanceBuffersMemory[i]);
+
+        void* data;
+        if (vkMapMemory(device, instanceBuffersMemory[i], 0, bufferSize, 0, &data) != VK_SUCCESS)
+            RUN_TIME_ERROR("createInstanceBuffers: failed to map instance buffer!");
+        instanceBuffersMapped[i] = (uint32_t*)data;
+    }
+}
+
+void VulkanApp::createBladePool()
+{
+    // with async compute the pool and the state are read across queues every frame, so they are
+    // concurrent instead of changing owner twice per frame
+    std::vector<uint32_t> families;
+    if (asyncCompute)
+        families = { queueFamilyIdx, computeFamilyIdx, transferFamilyIdx };
+    createBuffer(grassField.bladeCapacity() * sizeof(BladeInstance), 
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Storage, bladePoolBuffer, bladePoolMemory, families);
+
+    // both halves start at offsets aligned for the dynamic storage buffer binding
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+    bladeStateStride = (grassField.bladeCapacity() * sizeof(glm::vec2) + alignment - 1) / alignment * alignment;
+    createBuffer(2 * bladeStateStride, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Storage, bladeStateBuffer, bladeStateMemory, 
+                 asyncCompute ? std::vector<uint32_t>{ queueFamilyIdx, computeFamilyIdx } : std::vector<uint32_t>());
+    stateHalf = 0;
+    stateReleasePending.assign(framesInFlight, false);
+
+    // per frame in flight staging for the chunks streamed in that frame
+    VkDeviceSize uploadSize = config.field.maxChunkUploads * grassField.bladesPerChunk() * sizeof(BladeInstance);
+    uploadBuffers.resize(framesInFlight);
+    uploadBuffersMemory.resize(framesInFlight);
+    uploadBuffersMapped.resize(framesInFlight);
+
+    for (size_t i = 0; i < framesInFlight; i++) {
+        createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     MemoryCategory::Staging, uploadBuffers[i], uploadBuffersMemory[i]);
+
+        void* data;
+        if (vkMapMemory(device, uploadBuffersMemory[i], 0, uploadSize, 0, &data) != VK_SUCCESS)
+            RUN_TIME_ERROR("createBladePool: failed to map upload buffer!");
+        uploadBuffersMapped[i] = (BladeInstance*)data;
+    }
+}
+
+void VulkanApp::createWindField()
+{
+    // one field per frame in flight, written by the cpu while older frames still read theirs
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+    VkDeviceSize fieldSize = WIND_FIELD_SIZE * WIND_FIELD_SIZE * sizeof(glm::vec2);
+    windStride = (fieldSize + alignment - 1) / alignment * alignment;
+    createBuffer(framesInFlight * windStride, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Storage,
+                 windBuffer, windMemory,
+                 asyncCompute ? std::vector<uint32_t>{ queueFamilyIdx, computeFamilyIdx } : std::vector<uint32_t>());
+
+    void* data;
+    if (vkMapMemory(device, windMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+        RUN_TIME_ERROR("createWindField: failed to map wind field buffer!");
+    windMapped = (uint8_t*)data;
+    std::cerr << "Wind field: " << WIND_FIELD_SIZE << "x" << WIND_FIELD_SIZE << " over " << config.windField.extent 
+              << " world units, " << config.windField.octaves << " octaves, " << fieldSize << " bytes per frame" << std::endl;
+}
+
+void VulkanApp::createSyncObjects()
+{
+    syncObj.imageAvailableSemaphores.resize(framesInFlight);
+    syncObj.renderFinishedSemaphores.resize(framesInFlight);
+    syncObj.inFlightFences.resize(framesInFlight);
+    syncObj.uploadFinishedSemaphores.resize(framesInFlight);
+    syncObj.simulationFinishedSemaphores.resize(framesInFlight);
+    syncObj.simulationUploadSemaphores.resize(framesInFlight);
+    syncObj.stateReleasedSemaphores.resize(framesInFlight);
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (size_t i = 0; i < framesInFlight; i++) 
+    {
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.imageAvailableSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.renderFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.uploadFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.simulationFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.simulationUploadSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &syncObj.stateReleasedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateFence    (device, &fenceInfo,     nullptr, &syncObj.inFlightFences[i]) != VK_SUCCESS) {
+            RUN_TIME_ERROR("createSyncObjects failed to create synchronization objects for a frame!");
+        }
+    }
+}
+
+void VulkanApp::createCommandPool()
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIdx;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        RUN_TIME_ERROR("createCommandPool failed to create command pool!");    
+
+    transferCommandPool = VK_NULL_HANDLE;
+    if (dedicatedTransfer) {
+        poolInfo.queueFamilyIndex = transferFamilyIdx;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            RUN_TIME_ERROR("createCommandPool failed to create transfer command pool!");
+    }
+    computeCommandPool = VK_NULL_HANDLE;
+    if (asyncCompute) {
+        poolInfo.queueFamilyIndex = computeFamilyIdx;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+            RUN_TIME_ERROR("createCommandPool failed to create compute command pool!");
+    }
+}
+
+void VulkanApp::createCommandBuffers() 
+{
+    commandBuffers.resize(framesInFlight);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        RUN_TIME_ERROR("createCommandBuffers: failed to allocate command buffers!");
+
+    if (dedicatedTransfer) {
+        transferCommandBuffers.resize(framesInFlight);
+        allocInfo.commandPool = transferCommandPool;
+        if (vkAllocateCommandBuffers(device, &allocInfo, transferCommandBuffers.data()) != VK_SUCCESS)
+            RUN_TIME_ERROR("createCommandBuffers: failed to allocate transfer command buffers!");
+    }
+    if (asyncCompute) {
+        computeCommandBuffers.resize(framesInFlight);
+        allocInfo.commandPool = computeCommandPool;
+        if (vkAllocateCommandBuffers(device, &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS)
+            RUN_TIME_ERROR("createCommandBuffers: failed to allocate compute command buffers!");
+    }
+}
+
+void VulkanApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) 
+        RUN_TIME_ERROR("recordCommandBuffer: failed to begin recording command buffer!");
+
+    if (timestamps) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, uint32_t(4 * currentFrame), 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, uint32_t(4 * currentFrame));
+    }
+
+    recordChunkUploads(commandBuffer);
+    if (bladeSimulation && !asyncCompute)
+        recordSimulation(commandBuffer);
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = screenBufferResources.swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = screenBufferResources.swapChainExtent;
+
+    VkClearValue clearValues[2] = {};
+    clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    clearValues[1].depthStencil = { 1.0f, 0 };
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+
+    uint32_t firstQuery = uint32_t(2 * currentFrame);
+    if (pipelineStatistics)
+        vkCmdResetQueryPool(commandBuffer, statisticsPool, firstQuery, 2);
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkBuffer vertexBuffers[] = { vertexBuffer, instanceBuffers[currentFrame] };
+    VkDeviceSize offsets[]   = { 0, 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, idxBuffer, 0, VK_INDEX_TYPE_UINT16);
+    descriptors.bind(commandBuffer, pipelineLayout, uint32_t(currentFrame * uniformStride), uint32_t(stateHalf * bladeStateStride),
+                     uint32_t(currentFrame * windStride));
+
+    PushConstants frameConstants = {};
+    frameConstants.viewProj = viewProj;
+    frameConstants.time = shaderTime;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, offsetof(PushConstants, draw), &frameConstants);
+
+    // the blade pool is in world space, the ground is centered on the streamed field
+    DrawParams groundParams = { grassField.center(), 0, 0 };
+    std::vector<DrawParams> grassParams(bladeLods.levelCount());
+    for (size_t lod = 0; lod < bladeLods.levelCount(); lod++)
+        grassParams[lod] = { glm::vec2(0.0f), uint32_t(lod), grassTexture };
+
+    // with the prepass the grass lays down depth first so the ground is rejected early behind it,
+    // the color pass then runs the texture lookup once per visible pixel
+    // the far lods play the baked flutter back instead of evaluating it
+    depthDraws.clear();
+    colorDraws.clear();
+    if (depthPrepass) {
+        for (size_t lod = 0; lod < bladeLods.levelCount(); lod++) {
+            VkPipeline grassDepth = lod >= vertexAnimationLod ? grassBakedDepthPipeline : grassDepthPipeline;
+            depthDraws.add(grassDepth, bladeLods.level(lod).range, grassParams[lod], bladeLods.bucketSize(lod), bladeLods.bucketOffset(lod));
+        }
+        depthDraws.add(groundDepthPipeline, groundRange, groundParams);
+    }
+    VkPipeline groundColor = depthPrepass ? groundEqualPipeline : groundPipeline;
+    VkPipeline grassColor  = depthPrepass ? grassEqualPipeline : grassPipeline;
+    VkPipeline bakedColor  = depthPrepass ? grassBakedEqualPipeline : grassBakedPipeline;
+    colorDraws.add(groundColor, groundRange, groundParams);
+    for (size_t lod = 0; lod < bladeLods.levelCount(); lod++)
+        colorDraws.add(lod >= vertexAnimationLod ? bakedColor : grassColor, bladeLods.level(lod).range, grassParams[lod],
+                       bladeLods.bucketSize(lod), bladeLods.bucketOffset(lod));
+
+    if (pipelineStatistics)
+        vkCmdBeginQuery(commandBuffer, statisticsPool, firstQuery, 0);
+    depthDraws.record(commandBuffer, pipelineLayout);
+    if (pipelineStatistics) {
+        vkCmdEndQuery(commandBuffer, statisticsPool, firstQuery);
+        vkCmdBeginQuery(commandBuffer, statisticsPool, firstQuery + 1, 0);
+    }
+    colorDraws.record(commandBuffer, pipelineLayout);
+    if (pipelineStatistics) {
+        vkCmdEndQuery(commandBuffer, statisticsPool, firstQuery + 1);
+        statisticsPending[currentFrame] = true;
+    }
+    vkCmdEndRenderPass(commandBuffer);
+    recordCapture(commandBuffer, imageIndex);
+
+    if (timestamps) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, uint32_t(4 * currentFrame + 1));
+        timestampsPending[currentFrame] = true;
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) 
+        RUN_TIME_ERROR("failed to record command buffer!");
+}
+
+void VulkanApp::createTexture()
+{
+    // all species layers are packed into one staging buffer and uploaded with a single copy
+    textureLayers = uint32_t(config.species.size());
+    // the species decode in parallel, failures are reported once all of them are back. Species
+    // sharing a source image share its bytes, the cache reads every file once
+    // baked layers are used straight from the archive, only loose files are decoded
+    std::vector<Image> sources(textureLayers);
+    std::vector<const unsigned char*> pixels(textureLayers, nullptr);
+    jobs.parallelFor(textureLayers, 1, [this, &sources, &pixels](uint32_t begin, uint32_t end) {
+        for (uint32_t layer = begin; layer < end; layer++) {
+            Image& source = sources[layer];
+            source.image = nullptr;
+            const std::string& path = assets.path(config.species[layer].texture);
+            const AssetSpan* baked = archive ? archive->find(path) : nullptr;
+            if (baked && baked->kind == AssetKind::ImageRGBA8) {
+                source.w = int(baked->width);
+                source.h = int(baked->height);
+                source.c = 4;
+                pixels[layer] = baked->data;
+                continue;
+            }
+            try {
+                const std::vector<unsigned char>& bytes = assets.bytes(config.species[layer].texture);
+                source.image = stbi_load_from_memory(bytes.data(), int(bytes.size()), &source.w, &source.h, &source.c, STBI_rgb_alpha);
+                pixels[layer] = source.image;
+            } catch (const std::exception&) {
+            }
+        }
+    });
+
+    std::vector<unsigned char> layers;
+    for (uint32_t layer = 0; layer < textureLayers; layer++) {
+        const SpeciesConfig& species = config.species[layer];
+        const Image& source = sources[layer];
+        if (pixels[layer] == nullptr) {
+            std::string errorMsg = "createTexture: can't load " + assets.path(species.texture);
+            RUN_TIME_ERROR(errorMsg.c_str());
+        }
+        if (layer == 0)
+            grassTextureImage = source;
+        else if (source.w != grassTextureImage.w || source.h != grassTextureImage.h)
+            RUN_TIME_ERROR("createTexture: species textures must have the same size");
+
+        size_t offset = layers.size();
+        layers.insert(layers.end(), pixels[layer], pixels[layer] + source.w * source.h * 4);
+        for (size_t i = offset; i < layers.size(); i += 4) {
+            for (int c = 0; c < 3; c++)
+                layers[i + c] = (unsigned char)std::min(255.0f, layers[i + c] * species.tint[c]);
+        }
+        stbi_image_free(source.image);
+    }
+    grassTextureImage.image = nullptr;
+    VkDeviceSize imageSize = layers.size();
+    textureMipLevels = uint32_t(std::floor(std::log2(std::max(grassTextureImage.w, grassTextureImage.h)))) + 1;
+
+    // blit down the chain when the sRGB format can be linearly filtered as a blit source,
+    // otherwise write the mips from a compute shader, which needs the queue to support compute and
+    // a view usage restriction for the sRGB view of the storage image
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+    const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | 
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    textureBlit = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    if (!textureBlit) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (!(families[queueFamilyIdx].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            std::cout << "Texture: no linear blit or compute support, mipmaps disabled" << std::endl;
+            textureMipLevels = 1;
+        } else if (!viewUsage) {
+            std::cout << "Texture: no linear blit or " << VK_KHR_MAINTENANCE2_EXTENSION_NAME << ", mipmaps disabled" << std::endl;
+            textureMipLevels = 1;
+        }
+    }
+    // only the compute path writes the image as UNORM storage, it is sampled through an sRGB view
+    bool storageMips = !textureBlit && textureMipLevels > 1;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = static_cast<uint32_t>(grassTextureImage.w);
     imageInfo.extent.height = static_cast<uint32_t>(grassTextureImage.h);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.mipLevels = textureMipLevels;
+    imageInfo.arrayLayers = textureLayers;
+    imageInfo.format = storageMips ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.flags = storageMips ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | 
+                      (textureBlit ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0) | (storageMips ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -832,35 +2108,20 @@ void VulkanApp::createTexture()
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(device, textureImage, &memoryRequirements);
 
-    uint32_t memoryTypeIndex = -1;
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-    {
-        if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-            ((memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
-                memoryTypeIndex = i;
-                break;
-            }
-    }
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    textureImageMemory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &textureImageMemory) != VK_SUCCESS) 
-        RUN_TIME_ERROR("failed to allocate texture image memory!");
-    
-    
     if (vkBindImageMemory(device, textureImage, textureImageMemory, 0) != VK_SUCCESS)
         RUN_TIME_ERROR("Error binding texture image memmory");
 
-    // create image view
+    // create image view, without the storage usage it would inherit
+    VkImageViewUsageCreateInfoKHR sampledUsage{};
+    sampledUsage.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO_KHR;
+    sampledUsage.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
     VkImageViewCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    createInfo.pNext = storageMips ? &sampledUsage : nullptr;
     createInfo.image = textureImage;
-    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
     createInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
     createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -868,9 +2129,9 @@ void VulkanApp::createTexture()
     createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.levelCount = textureMipLevels;
     createInfo.subresourceRange.baseArrayLayer = 0;
-    createInfo.subresourceRange.layerCount = 1;
+    createInfo.subresourceRange.layerCount = textureLayers;
 
     if (vkCreateImageView(device, &createInfo, nullptr, &textureImageView) != VK_SUCCESS)
         RUN_TIME_ERROR("failed to create texture image views!");
@@ -889,36 +2150,18 @@ void VulkanApp::createTexture()
     VkMemoryRequirements bufferMemoryRequirements;
     vkGetBufferMemoryRequirements(device, stagingBuffer, &bufferMemoryRequirements);
 
-    memoryTypeIndex = -1;
-    uint32_t bit = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-    {
-        if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-            ((memoryProperties.memoryTypes[i].propertyFlags & bit) == bit)) {
-                memoryTypeIndex = i;
-                break;
-            }
-    }
-
-    VkMemoryAllocateInfo buffAllocInfo{};
-    buffAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    buffAllocInfo.allocationSize = bufferMemoryRequirements.size;
-    buffAllocInfo.memoryTypeIndex = memoryTypeIndex;
-
-    if (vkAllocateMemory(device, &buffAllocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) 
-        RUN_TIME_ERROR("failed to allocate staging buffer memory for texture image!");
-    
+    stagingBufferMemory = allocateMemory(bufferMemoryRequirements, 
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         MemoryCategory::Staging);
 
     if (vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0) != VK_SUCCESS)
         RUN_TIME_ERROR("failed to bind staging buffer memory for texture image!");
 
     void* data;
     vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, grassTextureImage.image, static_cast<size_t>(imageSize));
+    memcpy(data, layers.data(), static_cast<size_t>(imageSize));
     vkUnmapMemory(device, stagingBufferMemory);
 
-    stbi_image_free(grassTextureImage.image);
-
     //sampler
     VkPhysicalDeviceProperties properties{};
     vkGetPhysicalDeviceProperties(physicalDevice, &properties);
@@ -937,6 +2180,8 @@ void VulkanApp::createTexture()
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = float(textureMipLevels);
 
     if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) 
         RUN_TIME_ERROR("failed to create texture sampler!");
@@ -945,119 +2190,154 @@ void VulkanApp::createTexture()
  
 }
 
-void VulkanApp::createDescriptorSetLayout() 
+void VulkanApp::createVertexAnimation()
 {
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 0;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 1;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {samplerLayoutBinding, uboLayoutBinding};
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = bindings.data();
+    vertexAnimationImage = VK_NULL_HANDLE;
+    vertexAnimationMemory = VK_NULL_HANDLE;
+    vertexAnimationView = VK_NULL_HANDLE;
+    vertexAnimationSampler = VK_NULL_HANDLE;
+    vertexAnimationStaging = VK_NULL_HANDLE;
+    vertexAnimationStagingMemory = VK_NULL_HANDLE;
+    vertexAnimationSlot = 0;
+    // started in initResources, normally done by now
+    jobs.wait(vertexAnimationBake);
+    vertexAnimation.report(std::cerr);
+
+    // a texel row per frame holds every vertex, a device with narrower images animates every lod
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    vertexAnimationLod = std::min(options.vertexAnimationLod, uint32_t(bladeLods.levelCount()));
+    if (vertexAnimation.width() > properties.limits.maxImageDimension2D) {
+        std::cerr << "Vertex animation: " << vertexAnimation.width() << " vertices, images are limited to "
+                  << properties.limits.maxImageDimension2D << " texels, every lod evaluates the flutter" << std::endl;
+        vertexAnimationLod = uint32_t(bladeLods.levelCount());
+    }
+    if (vertexAnimationLod == bladeLods.levelCount())
+        return;
 
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) 
-        RUN_TIME_ERROR("failed to create descriptor set layout!");
+    // R8_SNORM is sampled on every device, the shader only fetches texels so no filtering is needed
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { vertexAnimation.width(), vertexAnimation.frames(), 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R8_SNORM;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    if (vkCreateImage(device, &imageInfo, nullptr, &vertexAnimationImage) != VK_SUCCESS)
+        RUN_TIME_ERROR("createVertexAnimation: failed to create image!");
 
-}
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, vertexAnimationImage, &memoryRequirements);
+    vertexAnimationMemory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture);
+    if (vkBindImageMemory(device, vertexAnimationImage, vertexAnimationMemory, 0) != VK_SUCCESS)
+        RUN_TIME_ERROR("createVertexAnimation: failed to bind image memory!");
+
+    // an array view of one layer, it shares the sampler2DArray slots with the blade texture
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = vertexAnimationImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = VK_FORMAT_R8_SNORM;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    if (vkCreateImageView(device, &viewInfo, nullptr, &vertexAnimationView) != VK_SUCCESS)
+        RUN_TIME_ERROR("createVertexAnimation: failed to create image view!");
 
-void VulkanApp::createDescriptorPool() 
-{
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(screenBufferResources.swapChainImages.size());
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(screenBufferResources.swapChainImages.size());
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &vertexAnimationSampler) != VK_SUCCESS)
+        RUN_TIME_ERROR("createVertexAnimation: failed to create sampler!");
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(screenBufferResources.swapChainImages.size());
+    // copied by copyVertices2GPU, freed once the initial upload has completed
+    createBuffer(vertexAnimation.bytes(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging,
+                 vertexAnimationStaging, vertexAnimationStagingMemory);
+    void* data;
+    vkMapMemory(device, vertexAnimationStagingMemory, 0, vertexAnimation.bytes(), 0, &data);
+    memcpy(data, vertexAnimation.texels().data(), vertexAnimation.bytes());
+    vkUnmapMemory(device, vertexAnimationStagingMemory);
+    std::cerr << "Vertex animation: lods " << vertexAnimationLod << " to " << bladeLods.levelCount() - 1
+              << " play the baked flutter back" << std::endl;
+}
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) 
-        RUN_TIME_ERROR("failed to create descriptor pool!");
+void VulkanApp::createDescriptorSetLayout() 
+{
+    descriptors.create(device, descriptorIndexing, framesInFlight);
+    std::cerr << "Descriptors: " << (descriptorIndexing ? "partially bound" : "fixed") << " array of " 
+              << MAX_TEXTURES << " textures" << std::endl;
 }
 
 void VulkanApp::createDescriptorSets() 
 {
-    std::vector<VkDescriptorSetLayout> layouts(screenBufferResources.swapChainImages.size(), descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(screenBufferResources.swapChainImages.size());
-    allocInfo.pSetLayouts = layouts.data();
-
-    descriptorSets.resize(screenBufferResources.swapChainImages.size());
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) 
-        RUN_TIME_ERROR("failed to allocate descriptor sets!");
-    
-
-    for (size_t i = 0; i < screenBufferResources.swapChainImages.size(); i++) {
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureImageView;
-        imageInfo.sampler = textureSampler;
-
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pImageInfo = &imageInfo;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-    }
+    grassTexture = descriptors.addTexture(textureImageView, textureSampler);
+    vertexAnimationSlot = vertexAnimationImage != VK_NULL_HANDLE ? descriptors.addTexture(vertexAnimationView, vertexAnimationSampler) : 0;
+    descriptors.setFrameBuffers(uniformBuffer, sizeof(UniformBufferObject), bladePoolBuffer, 
+                                bladeStateBuffer, grassField.bladeCapacity() * sizeof(glm::vec2),
+                                windBuffer, WIND_FIELD_SIZE * WIND_FIELD_SIZE * sizeof(glm::vec2));
 }
 
-void VulkanApp::copyVertices2GPU()
+VkCommandBuffer VulkanApp::beginOneTimeCommands(VkCommandPool pool)
 {
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
+    allocInfo.commandPool = pool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer cmdBuff;
     if (vkAllocateCommandBuffers(device, &allocInfo, &cmdBuff) != VK_SUCCESS)
-        RUN_TIME_ERROR("copyVertices2GPU: failed to allocate command buffer!");
+        RUN_TIME_ERROR("beginOneTimeCommands: failed to allocate command buffer!");
 
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; 
-    
     vkBeginCommandBuffer(cmdBuff, &beginInfo); 
-    vkCmdUpdateBuffer(cmdBuff, vertexBuffer, 0, vertices.size() * sizeof(float), vertices.data());
+    return cmdBuff;
+}
+
+// release (on the source family) or acquire (on the destination family) half of an ownership transfer
+static VkBufferMemoryBarrier ownershipBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcFamily, 
+                                              uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    return barrier;
+}
+
+void VulkanApp::copyVertices2GPU()
+{
+    // the copies go to the transfer queue, the mipmaps need blits or compute and stay on graphics
+    initialUpload = PendingUpload();
+    initialUpload.graphicsCommands = beginOneTimeCommands(commandPool);
+    VkCommandBuffer cmdBuff = initialUpload.graphicsCommands;
+    if (dedicatedTransfer) {
+        initialUpload.transferCommands = beginOneTimeCommands(transferCommandPool);
+        cmdBuff = initialUpload.transferCommands;
+    }
+
+    vkCmdUpdateBuffer(cmdBuff, vertexBuffer, 0, vertexData.size(), vertexData.data());
     vkCmdUpdateBuffer(cmdBuff, idxBuffer, 0, vertIdxs.size() * sizeof(uint16_t), vertIdxs.data());
 
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuff);
+    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuff, 
+                          0, textureMipLevels);
     VkBufferImageCopy region{};
     region.bufferOffset = 0;
     region.bufferRowLength = 0;
@@ -1065,70 +2345,357 @@ void VulkanApp::copyVertices2GPU()
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel = 0;
     region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.layerCount = textureLayers;
     region.imageOffset = {0, 0, 0};
     region.imageExtent = { static_cast<unsigned int>(grassTextureImage.w), static_cast<unsigned int>(grassTextureImage.h), 1 };
 
     vkCmdCopyBufferToImage(cmdBuff, stagingBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuff);
-    
-    vkEndCommandBuffer(cmdBuff);
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1; 
-    submitInfo.pCommandBuffers = &cmdBuff;
-                                         
-    VkFence fence;
+    if (dedicatedTransfer) {
+        std::array<VkBufferMemoryBarrier, 2> buffers = {
+            ownershipBarrier(vertexBuffer, 0, VK_WHOLE_SIZE, transferFamilyIdx, queueFamilyIdx, 0, 0),
+            ownershipBarrier(idxBuffer,    0, VK_WHOLE_SIZE, transferFamilyIdx, queueFamilyIdx, 0, 0),
+        };
+        VkImageMemoryBarrier image{};
+        image.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image.srcQueueFamilyIndex = transferFamilyIdx;
+        image.dstQueueFamilyIndex = queueFamilyIdx;
+        image.image = textureImage;
+        image.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, textureMipLevels, 0, VK_REMAINING_ARRAY_LAYERS };
+
+        // release
+        for (auto& barrier : buffers)
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        image.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(initialUpload.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, uint32_t(buffers.size()), buffers.data(), 1, &image);
+
+        // acquire, after the semaphore wait at the transfer stage
+        for (auto& barrier : buffers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        }
+        image.srcAccessMask = 0;
+        image.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(initialUpload.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             0, nullptr, uint32_t(buffers.size()), buffers.data(), 1, &image);
+        vkEndCommandBuffer(initialUpload.transferCommands);
+    }
+    else {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    // both state halves start at rest
+    vkCmdFillBuffer(initialUpload.graphicsCommands, bladeStateBuffer, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier stateBarrier{};
+    stateBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    stateBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    stateBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    VkPipelineStageFlags stateReaders = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    if (bladeSimulation && !asyncCompute)
+        stateReaders |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    vkCmdPipelineBarrier(initialUpload.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, stateReaders, 0,
+                         1, &stateBarrier, 0, nullptr, 0, nullptr);
+
+    // the baked flutter is small and only read by the vertex shader, it goes through graphics
+    if (vertexAnimationImage != VK_NULL_HANDLE) {
+        transitionImageLayout(vertexAnimationImage, VK_FORMAT_R8_SNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              initialUpload.graphicsCommands);
+        VkBufferImageCopy animationRegion{};
+        animationRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        animationRegion.imageExtent = { vertexAnimation.width(), vertexAnimation.frames(), 1 };
+        vkCmdCopyBufferToImage(initialUpload.graphicsCommands, vertexAnimationStaging, vertexAnimationImage,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &animationRegion);
+        transitionImageLayout(vertexAnimationImage, VK_FORMAT_R8_SNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, initialUpload.graphicsCommands);
+    }
+
+    generateMipmaps(initialUpload.graphicsCommands);
+    vkEndCommandBuffer(initialUpload.graphicsCommands);
+
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.flags = 0;
-    if (vkCreateFence(device, &fenceCreateInfo, NULL, &fence) != VK_SUCCESS)
+    if (vkCreateFence(device, &fenceCreateInfo, NULL, &initialUpload.fence) != VK_SUCCESS)
         RUN_TIME_ERROR("copyVertices2GPU: error creating fense");
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS)
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (dedicatedTransfer) {
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &initialUpload.transferFinished) != VK_SUCCESS)
+            RUN_TIME_ERROR("copyVertices2GPU: error creating semaphore");
+
+        submitInfo.commandBufferCount = 1; 
+        submitInfo.pCommandBuffers = &initialUpload.transferCommands;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &initialUpload.transferFinished;
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            RUN_TIME_ERROR("copyVertices2GPU: transfer submit failed");
+
+        submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &initialUpload.transferFinished;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    submitInfo.commandBufferCount = 1; 
+    submitInfo.pCommandBuffers = &initialUpload.graphicsCommands;
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, initialUpload.fence) != VK_SUCCESS)
         RUN_TIME_ERROR("copyVertices2GPU: submit failed");
+    // not waited for here, the rest of the startup overlaps with the upload
+}
 
-    if (vkWaitForFences(device, 1, &fence, VK_TRUE, 100000000000) != VK_SUCCESS)
-        RUN_TIME_ERROR("copyVertices2GPU: fence wait failed");
+void VulkanApp::finishInitialUpload()
+{
+    if (initialUpload.fence == VK_NULL_HANDLE)
+        return;
+    if (vkWaitForFences(device, 1, &initialUpload.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+        RUN_TIME_ERROR("finishInitialUpload: fence wait failed");
+
+    vkDestroyFence(device, initialUpload.fence, NULL);
+    vkDestroySemaphore(device, initialUpload.transferFinished, nullptr);
+    vkFreeCommandBuffers(device, commandPool, 1, &initialUpload.graphicsCommands);
+    if (initialUpload.transferCommands != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &initialUpload.transferCommands);
+    initialUpload = PendingUpload();
+    // the texture is in its image now
+    memoryTracker.release(stagingBufferMemory);
+    deletionQueue.retire(frameIndex, UniqueBuffer(device, stagingBuffer));
+    deletionQueue.retire(frameIndex, UniqueMemory(device, stagingBufferMemory));
+    stagingBuffer = VK_NULL_HANDLE;
+    stagingBufferMemory = VK_NULL_HANDLE;
+    if (vertexAnimationStaging != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, vertexAnimationStaging, nullptr);
+        freeMemory(vertexAnimationStagingMemory);
+        vertexAnimationStaging = VK_NULL_HANDLE;
+        vertexAnimationStagingMemory = VK_NULL_HANDLE;
+    }
+}
 
-    vkDestroyFence(device, fence, NULL);
-    vkFreeCommandBuffers(device, commandPool, 1, &cmdBuff);
+void VulkanApp::generateMipmaps(VkCommandBuffer commandBuffer)
+{
+    if (!textureBlit) {
+        generateMipmapsCompute(commandBuffer);
+        return;
+    }
+
+    int32_t width = grassTextureImage.w;
+    int32_t height = grassTextureImage.h;
+    for (uint32_t i = 1; i < textureMipLevels; i++) {
+        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, commandBuffer, i - 1);
+
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = textureLayers;
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { width, height, 1 };
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { width, height, 1 };
+
+        vkCmdBlitImage(commandBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+                       textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+
+    // every level but the last has been read as a blit source, the last one was only written
+    uint32_t last = textureMipLevels - 1;
+    if (last > 0)
+        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandBuffer, 0, last);
+    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandBuffer, last);
+}
+
+void VulkanApp::generateMipmapsCompute(VkCommandBuffer commandBuffer)
+{
+    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, commandBuffer, 0, textureMipLevels);
+    if (textureMipLevels > 1) {
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        for (uint32_t i = 0; i < 2; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+        VkDescriptorSetLayout setLayoutHandle;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayoutHandle) != VK_SUCCESS)
+            RUN_TIME_ERROR("generateMipmapsCompute: failed to create descriptor set layout!");
+        UniqueDescriptorSetLayout setLayout(device, setLayoutHandle);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayoutHandle;
+        VkPipelineLayout layoutHandle;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layoutHandle) != VK_SUCCESS)
+            RUN_TIME_ERROR("generateMipmapsCompute: failed to create pipeline layout!");
+        UniquePipelineLayout layout(device, layoutHandle);
+
+        UniqueShaderModule shaderModule(device, loadShader("../shaders/mipmap.comp.spv"));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule.get();
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout.get();
+        VkPipeline pipelineHandle;
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipelineHandle) != VK_SUCCESS)
+            RUN_TIME_ERROR("generateMipmapsCompute: failed to create compute pipeline!");
+        UniquePipeline pipeline(device, pipelineHandle);
+
+        // one UNORM storage view per level, the sampled view stays sRGB
+        std::vector<UniqueImageView> views;
+        for (uint32_t i = 0; i < textureMipLevels; i++) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = textureImage;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+            viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = i;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = textureLayers;
+            VkImageView view;
+            if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+                RUN_TIME_ERROR("generateMipmapsCompute: failed to create mip view!");
+            views.emplace_back(device, view);
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get());
+        uint32_t width = uint32_t(grassTextureImage.w);
+        uint32_t height = uint32_t(grassTextureImage.h);
+        for (uint32_t i = 1; i < textureMipLevels; i++) {
+            // transient sets of the first frame, the pool is reset when that frame starts
+            VkDescriptorSet set = descriptors.allocate(0, setLayout.get());
+
+            VkDescriptorImageInfo imageInfos[2] = {};
+            VkWriteDescriptorSet writes[2] = {};
+            for (uint32_t j = 0; j < 2; j++) {
+                imageInfos[j].imageView = views[i - 1 + j].get();
+                imageInfos[j].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[j].dstSet = set;
+                writes[j].dstBinding = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                writes[j].pImageInfo = &imageInfos[j];
+            }
+            vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout.get(), 0, 1, &set, 0, nullptr);
+            vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, textureLayers);
+            // the level just written is the source of the next dispatch
+            transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, commandBuffer, i);
+        }
+
+        // the upload has not been submitted yet, the objects go once the first frames have completed
+        deletionQueue.retire(frameIndex, std::move(pipeline));
+        deletionQueue.retire(frameIndex, std::move(layout));
+        deletionQueue.retire(frameIndex, std::move(setLayout));
+        for (auto& view : views)
+            deletionQueue.retire(frameIndex, std::move(view));
+    }
+    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandBuffer, 0, textureMipLevels);
 }
 
 void VulkanApp::drawFrame()
 {
+    // the mipmap pass of the startup upload allocated from the descriptor pool of frame 0
+    finishInitialUpload();
     vkWaitForFences(device, 1, &syncObj.inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
     vkResetFences(device, 1, &syncObj.inFlightFences[currentFrame]);
-
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(device, screenBufferResources.swapChain, UINT64_MAX, syncObj.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    readStatistics(uint32_t(currentFrame));
+    readTimestamps(uint32_t(currentFrame));
+    collectCapture(uint32_t(currentFrame));
+    descriptors.beginFrame(uint32_t(currentFrame));
+    // the frame that used this slot before has completed, and every frame ahead of it
+    if (frameIndex >= framesInFlight)
+        deletionQueue.collect(frameIndex - framesInFlight);
+
+    // headless, every frame in flight has its own image
+    uint32_t imageIndex = uint32_t(currentFrame);
+    if (!options.headless)
+        vkAcquireNextImageKHR(device, screenBufferResources.swapChain, UINT64_MAX, syncObj.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
     
-    VkSemaphore waitSemaphores[] = { syncObj.imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-
-    updateUniformBuffer(imageIndex);
+    streamField(currentFrame);
+    bool uploadSubmitted = submitChunkUploads();
+    updateUniformBuffer(uint32_t(currentFrame));
+    updateWind(uint32_t(currentFrame));
+    // overlaps with the previous frame still rendering on the graphics queue
+    bool simulationSubmitted = submitSimulation(uploadSubmitted);
+    updateInstances(currentFrame);
+    vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    if (!options.headless) {
+        waitSemaphores.push_back(syncObj.imageAvailableSemaphores[currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    if (uploadSubmitted) {
+        waitSemaphores.push_back(syncObj.uploadFinishedSemaphores[currentFrame]);
+        waitStages.push_back(bladeSimulation && !asyncCompute ? 
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    }
+    if (simulationSubmitted) {
+        waitSemaphores.push_back(syncObj.simulationFinishedSemaphores[currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    }
     
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.waitSemaphoreCount = uint32_t(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
 
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-
-    VkSemaphore signalSemaphores[] = { syncObj.renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+    // the simulation two frames ahead overwrites the state half read here
+    std::vector<VkSemaphore> signalSemaphores;
+    if (!options.headless)
+        signalSemaphores.push_back(syncObj.renderFinishedSemaphores[currentFrame]);
+    if (asyncCompute)
+        signalSemaphores.push_back(syncObj.stateReleasedSemaphores[currentFrame]);
+    submitInfo.signalSemaphoreCount = uint32_t(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
     if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, syncObj.inFlightFences[currentFrame]) != VK_SUCCESS)
         RUN_TIME_ERROR("drawFrame: failed to submit draw command buffer!");
+    if (asyncCompute)
+        stateReleasePending[currentFrame] = true;
+    if (options.headless) {
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return;
+    }
     
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores= signalSemaphores;
+    presentInfo.pWaitSemaphores= &syncObj.renderFinishedSemaphores[currentFrame];
 
     VkSwapchainKHR swapChains[] = { screenBufferResources.swapChain };
     presentInfo.swapchainCount = 1;
@@ -1136,37 +2703,322 @@ void VulkanApp::drawFrame()
     presentInfo.pImageIndices = &imageIndex;
     
     vkQueuePresentKHR(presentQueue, &presentInfo);
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
-void VulkanApp::updateUniformBuffer(uint32_t currentImage) {
+void VulkanApp::updateUniformBuffer(uint32_t frame) {
     static auto startTime = std::chrono::high_resolution_clock::now();
 
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
     
     UniformBufferObject ubo;
-    //ubo.time = 2;//std::rand() % 10;
-    ubo.proj = glm::perspective(glm::radians(45.0f), 
-        screenBufferResources.swapChainExtent.width / (float) screenBufferResources.swapChainExtent.height, 0.1f, 10.0f);
+    const CameraConfig& camera = config.camera;
+    glm::mat4 proj = glm::perspective(glm::radians(camera.fovDegrees), 
+        screenBufferResources.swapChainExtent.width / (float) screenBufferResources.swapChainExtent.height, camera.nearPlane, camera.farPlane);
     /*for(int i =0; i < 4; i++){
         for(int j = 0; j < 4; j++)
         {
-            std::cerr << ubo.proj[i][j] << " ";
+            std::cerr << proj[i][j] << " ";
         }
         std::cerr << '\n';
     }*/
-    ubo.proj[1][1] *= -1;
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 0.1f));
-    ubo.view = glm::lookAt(glm::vec3(0.0f, 2.5f, -6.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.time = nFrame;
-    void* data;
-    vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+    proj[1][1] *= -1;
+    glm::mat4 model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 0.1f));
+    glm::mat4 view = glm::lookAt(cameraTarget + glm::vec3(camera.offset[0], camera.offset[1], camera.offset[2]), cameraTarget, glm::vec3(0.0f, 0.0f, 1.0f));
+    shaderTime = nFrame;
+    ubo.field = glm::vec4(grassField.center(), 0.0f, grassField.halfExtent());
+    ubo.positionBounds = glm::vec4(meshLayout.attributes[0].min, meshLayout.attributes[0].extent);
+    ubo.texCoordBounds = glm::vec4(meshLayout.attributes[1].min, meshLayout.attributes[1].extent);
+    ubo.wind = glm::vec4(windField.scale(), 0.0f, 0.0f, 0.0f);
+    ubo.animation = glm::uvec4(vertexAnimationSlot, vertexAnimation.frames(), 0, 0);
+    viewProj = proj * view * model;
+    focalPixels = std::fabs(proj[1][1]) * screenBufferResources.swapChainExtent.height * 0.5f;
+    memcpy(uniformBufferMapped + frame * uniformStride, &ubo, sizeof(ubo));
     nFrame++;
 }
 
+void VulkanApp::updateWind(uint32_t frame)
+{
+    // the same clock as the vertex shader, a headless run starts it at zero
+    windField.update(jobs, shaderTime, reinterpret_cast<glm::vec2*>(windMapped + frame * windStride));
+}
+
+void VulkanApp::updateCamera(float dt)
+{
+    const float speed = config.camera.speed;
+    glm::vec3 move(0.0f);
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) move.z += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) move.z -= 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) move.x += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) move.x -= 1.0f;
+    cameraTarget += move * speed * dt;
+
+    bool prepassKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (prepassKey && !prepassKeyDown)
+        depthPrepass = !depthPrepass;
+    prepassKeyDown = prepassKey;
+
+    bool gustKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gustKey && !gustKeyDown) {
+        gust = !gust;
+        // in-flight frames keep using the previous variants, nothing is destroyed here
+        createGraphicsPipeline();
+        std::cerr << "Wind: gust " << (gust ? "on" : "off") << ", " << pipelineVariants.size() << " pipeline variants, " 
+                  << pipelineMisses << " built, " << pipelineHits << " reused" << std::endl;
+    }
+    gustKeyDown = gustKey;
+}
+
+void VulkanApp::streamField(uint32_t frame)
+{
+    chunkUploads.clear();
+    grassField.update(glm::vec2(cameraTarget.x, cameraTarget.z), frameIndex++, config.field.maxChunkUploads, chunkUploads);
+
+    const uint32_t bladesPerChunk = grassField.bladesPerChunk();
+    for (size_t i = 0; i < chunkUploads.size(); i++) {
+        memcpy(uploadBuffersMapped[frame] + i * bladesPerChunk, chunkUploads[i].blades.data(), 
+               bladesPerChunk * sizeof(BladeInstance));
+        bladeLods.reset(chunkUploads[i].slot * bladesPerChunk, bladesPerChunk);
+    }
+}
+
+static std::vector<VkBufferCopy> chunkCopyRegions(const std::vector<ChunkUpload>& uploads, uint32_t bladesPerChunk)
+{
+    std::vector<VkBufferCopy> regions(uploads.size());
+    for (size_t i = 0; i < uploads.size(); i++) {
+        regions[i].srcOffset = i * bladesPerChunk * sizeof(BladeInstance);
+        regions[i].dstOffset = uploads[i].slot * bladesPerChunk * sizeof(BladeInstance);
+        regions[i].size      = bladesPerChunk * sizeof(BladeInstance);
+    }
+    return regions;
+}
+
+bool VulkanApp::submitChunkUploads()
+{
+    if (!dedicatedTransfer || chunkUploads.empty())
+        return false;
+
+    // the copy runs on the transfer queue while the previous frames render, the slots written
+    // here are not read by any frame in flight (GrassField delays their reuse)
+    VkCommandBuffer commandBuffer = transferCommandBuffers[currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitChunkUploads: failed to begin recording transfer command buffer!");
+
+    std::vector<VkBufferCopy> regions = chunkCopyRegions(chunkUploads, grassField.bladesPerChunk());
+    vkCmdCopyBuffer(commandBuffer, uploadBuffers[currentFrame], bladePoolBuffer, uint32_t(regions.size()), regions.data());
+
+    // release the written slots to the graphics family, recordChunkUploads acquires them;
+    // with async compute the pool is concurrent and the semaphores alone order the copy
+    if (!asyncCompute) {
+        std::vector<VkBufferMemoryBarrier> barriers;
+        for (const VkBufferCopy& region : regions)
+            barriers.push_back(ownershipBarrier(bladePoolBuffer, region.dstOffset, region.size, transferFamilyIdx, queueFamilyIdx,
+                                                VK_ACCESS_TRANSFER_WRITE_BIT, 0));
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, uint32_t(barriers.size()), barriers.data(), 0, nullptr);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitChunkUploads: failed to record transfer command buffer!");
+
+    // the simulation reads the new blades as well
+    VkSemaphore signalSemaphores[] = { syncObj.uploadFinishedSemaphores[currentFrame], syncObj.simulationUploadSemaphores[currentFrame] };
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = asyncCompute ? 2 : 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+    // no fence, the frame's fence covers it since the graphics submission waits on the semaphore
+    if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitChunkUploads: failed to submit transfer command buffer!");
+    return true;
+}
+
+void VulkanApp::recordChunkUploads(VkCommandBuffer commandBuffer)
+{
+    if (chunkUploads.empty())
+        return;
+
+    // async, the copies are on the transfer queue or in the compute command buffer
+    if (asyncCompute)
+        return;
+
+    // the inline simulation reads every slot of the pool
+    VkPipelineStageFlags readers = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    if (bladeSimulation)
+        readers |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    std::vector<VkBufferCopy> regions = chunkCopyRegions(chunkUploads, grassField.bladesPerChunk());
+    if (dedicatedTransfer) {
+        // acquire the slots released by submitChunkUploads, after the semaphore wait at the first reading stage
+        std::vector<VkBufferMemoryBarrier> barriers;
+        for (const VkBufferCopy& region : regions)
+            barriers.push_back(ownershipBarrier(bladePoolBuffer, region.dstOffset, region.size, transferFamilyIdx, queueFamilyIdx,
+                                                0, VK_ACCESS_SHADER_READ_BIT));
+        vkCmdPipelineBarrier(commandBuffer, readers, readers, 0,
+                             0, nullptr, uint32_t(barriers.size()), barriers.data(), 0, nullptr);
+        return;
+    }
+
+    // a reused slot may still be read by frames in flight
+    vkCmdPipelineBarrier(commandBuffer, readers, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 0, nullptr);
+    vkCmdCopyBuffer(commandBuffer, uploadBuffers[currentFrame], bladePoolBuffer, uint32_t(regions.size()), regions.data());
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = bladePoolBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readers, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void VulkanApp::recordSimulation(VkCommandBuffer commandBuffer)
+{
+    uint32_t firstQuery = uint32_t(4 * currentFrame + 2);
+    if (timestamps) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, firstQuery, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, firstQuery);
+    }
+
+    // the half read was written by the previous simulation; inline, the half written was
+    // read by the draws two frames ago (async, the stateReleased semaphore orders that)
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (!asyncCompute)
+        srcStages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    SimulationConstants constants = {};
+    constants.dt            = 1.0f; // shaderTime counts frames
+    constants.bladeCount    = grassField.bladeCapacity();
+    constants.windAmplitude = sceneConstants.windAmplitude;
+    constants.windScale     = windField.scale();
+    if (gust)
+        constants.windAmplitude *= 2.0f;
+
+    uint32_t windOffset = uint32_t(currentFrame * windStride);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulationPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulationLayout, 0, 1, &simulationSets[stateHalf], 1, &windOffset);
+    vkCmdPushConstants(commandBuffer, simulationLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (constants.bladeCount + 63) / 64, 1, 1);
+
+    if (!asyncCompute) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    if (timestamps)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstQuery + 1);
+}
+
+bool VulkanApp::submitSimulation(bool uploadSubmitted)
+{
+    if (!bladeSimulation)
+        return false;
+    stateHalf = uint32_t(frameIndex % 2);
+    if (!asyncCompute)
+        return false;
+
+    VkCommandBuffer commandBuffer = computeCommandBuffers[currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitSimulation: failed to begin recording compute command buffer!");
+
+    // without a transfer family the streamed chunks are copied here, before the simulation reads them
+    if (!dedicatedTransfer && !chunkUploads.empty()) {
+        std::vector<VkBufferCopy> regions = chunkCopyRegions(chunkUploads, grassField.bladesPerChunk());
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdCopyBuffer(commandBuffer, uploadBuffers[currentFrame], bladePoolBuffer, uint32_t(regions.size()), regions.data());
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    recordSimulation(commandBuffer);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitSimulation: failed to record compute command buffer!");
+
+    // the draws two frames back read the half written now, they used the slot after the next one
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    size_t releasedFrame = (currentFrame + 2 * framesInFlight - 2) % framesInFlight;
+    if (stateReleasePending[releasedFrame]) {
+        waitSemaphores.push_back(syncObj.stateReleasedSemaphores[releasedFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        stateReleasePending[releasedFrame] = false;
+    }
+    if (uploadSubmitted) {
+        waitSemaphores.push_back(syncObj.simulationUploadSemaphores[currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = uint32_t(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &syncObj.simulationFinishedSemaphores[currentFrame];
+    // the graphics submission of the frame waits on it, so the frame's fence covers this one too
+    if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        RUN_TIME_ERROR("submitSimulation: failed to submit compute command buffer!");
+    return true;
+}
+
+void VulkanApp::updateInstances(uint32_t frame)
+{
+    bladeLods.select(jobs, grassField.visibleBlades(), grassField.bladeCenters(), viewProj, focalPixels, sceneConstants.bladeScale);
+
+    const std::vector<uint32_t>& ids = bladeLods.bucketedInstances();
+    memcpy(instanceBuffersMapped[frame], ids.data(), ids.size() * sizeof(uint32_t));
+
+    auto now = std::chrono::high_resolution_clock::now();
+    float elapsed = std::chrono::duration<float>(now - lastReport).count();
+    if (elapsed > 1.0f) {
+        // the budget check warns on its own, the reports are opt in
+        memoryTracker.updateBudget();
+        if (options.stats) {
+            bladeLods.report(std::cerr);
+            grassField.report(std::cerr, elapsed);
+            windField.report(std::cerr);
+            uint64_t analyticVertices = 0, bakedVertices = 0;
+            for (size_t lod = 0; lod < bladeLods.levelCount(); lod++)
+                (lod >= vertexAnimationLod ? bakedVertices : analyticVertices) += 
+                    uint64_t(bladeLods.bucketSize(lod)) * bladeLods.level(lod).range.vertexCount;
+            VertexAnimation::reportSavings(std::cerr, analyticVertices, bakedVertices);
+            reportStatistics(std::cerr);
+            reportTimestamps(std::cerr);
+            memoryTracker.report(std::cerr);
+            if (capture)
+                capture->report(std::cerr);
+        }
+        lastReport = now;
+    }
+}
+
 void VulkanApp::initDebugReportCallback()
 {
     VkDebugReportCallbackCreateInfoEXT createInfo = {};
@@ -1183,11 +3035,16 @@ void VulkanApp::initDebugReportCallback()
 }
 
 VkShaderModule VulkanApp::createShaderModule(const std::vector<uint32_t>& code)
+{
+    return createShaderModule(code.data(), code.size() * sizeof(uint32_t));
+}
+
+VkShaderModule VulkanApp::createShaderModule(const uint32_t* code, size_t size)
 {
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size() * sizeof(uint32_t);
-    createInfo.pCode = code.data();
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
@@ -1196,12 +3053,117 @@ VkShaderModule VulkanApp::createShaderModule(const std::vector<uint32_t>& code)
     return shaderModule;
 }
 
+VkShaderModule VulkanApp::loadShader(const char* filename)
+{
+    const AssetSpan* baked = archive && !options.shaderReload ? archive->find(filename) : nullptr;
+    if (baked && baked->kind == AssetKind::Raw && baked->size % sizeof(uint32_t) == 0)
+        return createShaderModule(baked->as<uint32_t>(), baked->size);
+
+    std::vector<uint32_t> code;
+    loadShaderModule(filename, code);
+    return createShaderModule(code);
+}
+
+uint32_t VulkanApp::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+    uint32_t typeIndex = memoryTracker.findType(typeBits, properties);
+    if (typeIndex == UINT32_MAX)
+        RUN_TIME_ERROR("findMemoryType: no suitable memory type!");
+    return typeIndex;
+}
+
+VkDeviceMemory VulkanApp::allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                         MemoryCategory category)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        std::string errorMsg = std::string("allocateMemory: failed to allocate ") + memoryCategoryName(category) + " memory!";
+        memoryTracker.report(std::cerr);
+        RUN_TIME_ERROR(errorMsg.c_str());
+    }
+    memoryTracker.record(memory, requirements.size, allocInfo.memoryTypeIndex, category);
+    return memory;
+}
+
+void VulkanApp::freeMemory(VkDeviceMemory memory)
+{
+    memoryTracker.release(memory);
+    vkFreeMemory(device, memory, nullptr);
+}
+
+void VulkanApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
+                             MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& memory,
+                             std::vector<uint32_t> families)
+{
+    std::sort(families.begin(), families.end());
+    families.erase(std::unique(families.begin(), families.end()), families.end());
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (families.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = uint32_t(families.size());
+        bufferInfo.pQueueFamilyIndices = families.data();
+    }
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) 
+        RUN_TIME_ERROR("createBuffer: failed to create buffer!");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+    memory = allocateMemory(memoryRequirements, properties, category);
+
+    if (vkBindBufferMemory(device, buffer, memory, 0) != VK_SUCCESS)
+        RUN_TIME_ERROR("createBuffer: failed to bind buffer memory!");
+}
+
 VkDevice& VulkanApp::operator()()
 {
     return device;
 }
 
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer) 
+// access and stage of the work on either side of a layout transition
+static void layoutAccess(VkImageLayout layout, bool source, VkAccessFlags& access, VkPipelineStageFlags& stage)
+{
+    switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        access = 0;
+        stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        access = VK_ACCESS_TRANSFER_WRITE_BIT;
+        stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        access = VK_ACCESS_TRANSFER_READ_BIT;
+        stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_GENERAL:
+        // storage image written by a compute shader
+        access = source ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        // the blade texture is sampled by the fragment shaders, the baked flutter by the vertex shader
+        access = VK_ACCESS_SHADER_READ_BIT;
+        stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        break;
+    default:
+        RUN_TIME_ERROR("unsupported layout transition!");
+    }
+}
+
+void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer,
+                           uint32_t baseMipLevel, uint32_t levelCount) 
 {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1211,29 +3173,17 @@ void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayo
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
+    layoutAccess(oldLayout, true, barrier.srcAccessMask, sourceStage);
+    layoutAccess(newLayout, false, barrier.dstAccessMask, destinationStage);
+    if (newLayout == VK_IMAGE_LAYOUT_UNDEFINED)
         RUN_TIME_ERROR("unsupported layout transition!");
-    }
 
     vkCmdPipelineBarrier(
         commandBuffer,
@@ -1252,6 +3202,54 @@ static void RunTimeError(const char* file, int line, const char* msg)
     throw std::runtime_error(strout.str().c_str());
 }
 
+std::string pipelineKey(const PipelineDesc& desc)
+{
+    std::stringstream key;
+    key << desc.vertShader << "|" << (desc.fragShader ? desc.fragShader : "-") << "|" 
+        << desc.depthCompare << desc.depthWrite << desc.colorWrite << desc.alphaToCoverage;
+    for (const VertexLayout& layout : desc.layouts)
+        key << "|" << layout.binding << ":" << layout.stride << ":" << layout.attributes.size();
+    // exact bit patterns, two constant sets only share a variant if the shader would see the same values
+    key << std::hex;
+    for (float value : desc.constants) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        key << "|" << bits;
+    }
+    return key.str();
+}
+
+VkSampleCountFlags supportedSampleCounts(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+}
+
+VkSampleCountFlagBits chooseSampleCount(VkPhysicalDevice physicalDevice, uint32_t requested)
+{
+    VkSampleCountFlags supported = supportedSampleCounts(physicalDevice);
+    uint32_t samples = VK_SAMPLE_COUNT_64_BIT;
+    while (samples > VK_SAMPLE_COUNT_1_BIT && (samples > requested || !(supported & samples)))
+        samples >>= 1;
+    return VkSampleCountFlagBits(samples);
+}
+
+VkFormat chooseDepthFormat(VkPhysicalDevice physicalDevice)
+{
+    // no stencil is used, prefer the formats without it
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM,
+                                    VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+    RUN_TIME_ERROR("chooseDepthFormat: no supported depth format!");
+    return VK_FORMAT_UNDEFINED;
+}
+
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) 
 {
     for (const auto& availableFormat : availableFormats) {
@@ -1263,14 +3261,12 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
     return availableFormats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) 
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred) 
 {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
-        } else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-            return availablePresentMode;
-        }
+    // fifo is the only mode every surface has
+    for (VkPresentModeKHR mode : { preferred, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end())
+            return mode;
     }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -1289,6 +3285,19 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, int wi
     }
 }
 
+bool deviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* name)
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (const VkExtensionProperties& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0)
+            return true;
+    }
+    return false;
+}
+
 uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities)
 {
     uint32_t imageCount = capabilities.minImageCount + 1;
@@ -21,15 +21,33 @@
 #include <cmath>
 #include <array>
 #include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <algorithm>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <chrono>
 
-const int WIDTH  = 800;
-const int HEIGHT = 800;
-const int MAX_FRAMES_IN_FLIGHT = 3;
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "BladeLod.h"
+#include "DrawList.h"
+#include "GrassField.h"
+#include "WindField.h"
+#include "VertexAnimation.h"
+#include "JobSystem.h"
+#include "NumberReader.h"
+#include "SceneConfig.h"
+#include "AssetArchive.h"
+#include "FrameCapture.h"
+#include "ShaderWatcher.h"
+#include "Descriptors.h"
+#include "DeletionQueue.h"
+#include "MemoryTracker.h"
 
 static char g_validationLayerData[256];
 static const char* g_debugReportExtName  = VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
@@ -46,11 +64,67 @@ struct Image
     unsigned char* image;
 };
 
+// rarely changing shader inputs, per frame and per draw values are push constants
 struct UniformBufferObject {
-    alignas(16) glm::mat4 model;
-    alignas(16) glm::mat4 view;
-    alignas(16) glm::mat4 proj;
-    alignas(16) float time;
+    alignas(16) glm::vec4 field; // xy - ground center, w - ground half extent
+    alignas(16) glm::vec4 positionBounds; // xy - min, zw - extent of the quantized position
+    alignas(16) glm::vec4 texCoordBounds;
+    alignas(16) glm::vec4 wind; // x - wind field repeats per world unit
+    alignas(16) glm::uvec4 animation; // x - vertex animation texture slot, y - frames in its loop
+};
+
+// push constants of simulate.comp
+struct SimulationConstants
+{
+    float    dt;
+    uint32_t bladeCount;
+    float    windAmplitude;
+    float    windScale; // wind field repeats per world unit
+};
+
+struct PipelineDesc
+{
+    const char*               vertShader;
+    const char*               fragShader; // nullptr for a depth only pipeline
+    std::vector<VertexLayout> layouts;
+    VkCompareOp               depthCompare;
+    bool                      depthWrite;
+    bool                      colorWrite;
+    bool                      alphaToCoverage;
+    std::vector<float>        constants;  // specialization constant i of both stages is constants[i]
+};
+
+struct PipelineVariant
+{
+    PipelineDesc desc;
+    VkPipeline   pipeline;
+};
+
+struct AppOptions
+{
+    uint32_t samples   = 4;     // requested MSAA sample count, clamped to what the device supports
+    bool     benchmark = false; // render every supported sample count for a fixed number of frames and exit
+    bool     shaderReload = false; // watch shaders/ and rebuild pipelines when a source changes
+    bool     asyncCompute = true;  // simulate on a separate compute family when the device has one
+    std::string scenePath = "../scenes/default.json"; // empty for the built-in scene
+    std::string archivePath = "assets.pak";           // written by asset_bake, empty to read the loose files
+    bool     stats = false;     // print the lod, streaming, wind, gpu time and memory reports once a second
+    bool     headless = false;  // no window, frames go to offscreen images, see VulkanApp::RenderOffscreen
+    std::string capturePath;          // "<name>.y4m" or a directory of ppm frames, empty to not capture
+    uint32_t captureFps = 60;         // frame rate written into the y4m header
+    uint32_t vertexAnimationLod = 2;  // first blade lod that plays the baked flutter, 0 for all, BLADE_LOD_LEVELS for none
+};
+
+// what a headless run rendered and measured
+struct OffscreenFrame
+{
+    uint32_t             width;
+    uint32_t             height;
+    std::vector<uint8_t> rgb;                 // rows top to bottom
+    uint32_t             settleFrames;        // frames until every chunk in the radius was resident
+    double               cpuMsPerFrame;       // wall time of the measured frames
+    double               gpuMsPerFrame;       // graphics queue timestamps, 0 when not supported
+    double               fragmentInvocations; // per frame, prepass and color, 0 when not supported
 };
 
 struct ScreenBufferResources
@@ -68,31 +142,80 @@ struct ScreenBufferResources
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence>     inFlightFences;
+    // signalled by the transfer queue once the chunks streamed in a frame are copied
+    std::vector<VkSemaphore> uploadFinishedSemaphores;
+    // async compute: the simulation of a frame is done, its uploads are copied (waited by the
+    // simulation), and the draws of a frame are done with the state half they read
+    std::vector<VkSemaphore> simulationFinishedSemaphores;
+    std::vector<VkSemaphore> simulationUploadSemaphores;
+    std::vector<VkSemaphore> stateReleasedSemaphores;
+  };
+
+  // startup upload, recorded on the transfer queue and handed over to graphics for the mipmaps
+  struct PendingUpload
+  {
+    VkFence         fence;
+    VkSemaphore     transferFinished;
+    VkCommandBuffer transferCommands;
+    VkCommandBuffer graphicsCommands;
   };
 
 class VulkanApp
 {
 public:
-    explicit VulkanApp() : 
-        requiredQuequeProps(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT){};
+    explicit VulkanApp(const AppOptions& options = AppOptions()) : 
+        requiredQuequeProps(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT), options(options),
+        config(loadSceneConfig(options.scenePath, assets)), framesInFlight(config.window.framesInFlight),
+        grassField(jobs, config.field.radius, uint32_t(config.species.size()), framesInFlight, config.field.bladesPerSide,
+                   config.constants.bladeScale),
+        windField(config.windField){};
     ~VulkanApp();
     void Init();
     void Run();
+    // headless only: waits for the field to stream in, restarts the simulation and the clock, renders
+    // frames and reads the last one back. The same options and frame count give the same image
+    void RenderOffscreen(uint32_t frames, OffscreenFrame& result);
     VkDevice& operator()();
 
 private:
     const VkQueueFlags           requiredQuequeProps;
+    const AppOptions             options;
+    // everything the scene description sets, loaded before any member that depends on it
+    AssetCache                   assets;
+    const SceneConfig            config;
+    const uint32_t               framesInFlight;
+    // baked copies of the assets, mapped once; anything missing from it is read from its file
+    std::unique_ptr<AssetArchive> archive;
     VkInstance                   instance;
     VkPhysicalDevice             physicalDevice;
     VkDevice                     device;
     uint32_t                     queueFamilyIdx;
     VkQueue                      graphicsQueue;
     VkQueue                      presentQueue;
+    // uploads go through a transfer only family when the device has one, through graphicsQueue otherwise
+    bool                         dedicatedTransfer;
+    uint32_t                     transferFamilyIdx;
+    VkQueue                      transferQueue;
+    // the blade simulation runs on a compute only family when there is one (async), inside the
+    // graphics command buffer when only the graphics family has compute, and not at all otherwise
+    bool                         bladeSimulation;
+    bool                         asyncCompute;
+    uint32_t                     computeFamilyIdx;
+    VkQueue                      computeQueue;
 
     GLFWwindow*                  window;
     VkSurfaceKHR                 surface;
     ScreenBufferResources        screenBufferResources;
+    // headless: the images that stand in for the swapchain, one per frame in flight
+    std::vector<VkDeviceMemory>  offscreenMemory;
     size_t                       currentFrame;
+    // frame capture: each frame copies its image into a free read back buffer, the buffer is handed
+    // to the encoder thread once the frame's fence has been waited for framesInFlight frames later
+    std::unique_ptr<FrameCapture> capture;
+    std::vector<VkBuffer>        captureBuffers;
+    std::vector<VkDeviceMemory>  captureMemory;
+    std::vector<int32_t>         captureFrameSlots; // per frame in flight, -1 when it copied nothing
+    bool                         captureCoherent;
 
     /*std::vector<float>           vertices = {
         -0.5f, -0.5f,0,0,0,0,0,
@@ -107,6 +230,32 @@ private:
 
     std::vector<float>           vertices;
     std::vector<uint16_t>        vertIdxs;
+    VertexLayout                 meshLayout;
+    VertexLayout                 instanceLayout;
+    std::vector<uint8_t>         vertexData;
+    MeshRange                    groundRange;
+    BladeLodChain                bladeLods;
+    glm::mat4                    viewProj;
+    float                        shaderTime;
+    float                        focalPixels;
+    // baked on the jobs while the device is set up; declared before them, so the workers are joined
+    // before the bake's output is destroyed even when Init throws
+    VertexAnimation              vertexAnimation;
+    JobCounter                   vertexAnimationBake;
+
+    // frame work (lod selection) and chunk generation, the render thread is worker 0
+    JobSystem                    jobs;
+    GrassField                   grassField;
+    // evaluated on the jobs every frame into that frame's slice of windBuffer, read by the grass
+    // vertex shader and the simulation
+    WindField                    windField;
+    VkBuffer                     windBuffer;
+    VkDeviceMemory               windMemory;
+    uint8_t*                     windMapped;
+    VkDeviceSize                 windStride;
+    glm::vec3                    cameraTarget;
+    uint64_t                     frameIndex;
+    std::vector<ChunkUpload>     chunkUploads;
 
     VkBuffer                     vertexBuffer;
     VkDeviceMemory               vertexMemory;
@@ -118,26 +267,139 @@ private:
     VkDeviceMemory               textureImageMemory;
     VkImageView                  textureImageView;
     VkSampler                    textureSampler;
+    uint32_t                     textureMipLevels;
+    uint32_t                     textureLayers;
+    // without linear blit support the image is created UNORM and mutable, mips are written by mipmap.comp
+    // (unless they are disabled, then it is a plain sRGB image)
+    bool                         textureBlit;
 
     VkBuffer                     stagingBuffer;
     VkDeviceMemory               stagingBufferMemory;
 
-    std::vector<VkBuffer>        uniformBuffers;
-    std::vector<VkDeviceMemory>  uniformBuffersMemory;
+    // the baked flutter in the global texture array, lods from vertexAnimationLod on read it
+    VkImage                      vertexAnimationImage;
+    VkDeviceMemory               vertexAnimationMemory;
+    VkImageView                  vertexAnimationView;
+    VkSampler                    vertexAnimationSampler;
+    VkBuffer                     vertexAnimationStaging;
+    VkDeviceMemory               vertexAnimationStagingMemory;
+    uint32_t                     vertexAnimationSlot;
+    uint32_t                     vertexAnimationLod;
+
+    // one slice per frame in flight, selected by the dynamic offset of the frame set
+    VkBuffer                     uniformBuffer;
+    VkDeviceMemory               uniformBufferMemory;
+    uint8_t*                     uniformBufferMapped;
+    VkDeviceSize                 uniformStride;
+
+    // per frame in flight: instance ids bucketed by lod
+    std::vector<VkBuffer>        instanceBuffers;
+    std::vector<VkDeviceMemory>  instanceBuffersMemory;
+    std::vector<uint32_t*>       instanceBuffersMapped;
+
+    // blade attributes of every resident chunk, one slot of bladesPerChunk() per chunk
+    VkBuffer                     bladePoolBuffer;
+    VkDeviceMemory               bladePoolMemory;
+    std::vector<VkBuffer>        uploadBuffers;
+    std::vector<VkDeviceMemory>  uploadBuffersMemory;
+    std::vector<BladeInstance*>  uploadBuffersMapped;
+    // two halves of lean state, the simulation of frame N reads half (N+1)%2 and writes half N%2
+    VkBuffer                     bladeStateBuffer;
+    VkDeviceMemory               bladeStateMemory;
+    VkDeviceSize                 bladeStateStride;
+    uint32_t                     stateHalf;
+    std::vector<bool>            stateReleasePending;
+    VkDescriptorSetLayout        simulationSetLayout;
+    VkPipelineLayout             simulationLayout;
+    VkPipeline                   simulationPipeline;
+    VkDescriptorPool             simulationPool;
+    std::array<VkDescriptorSet, 2> simulationSets;
 
     SyncObj                      syncObj;
     VkCommandPool                commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
-
-    VkDescriptorPool             descriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkCommandPool                transferCommandPool;
+    std::vector<VkCommandBuffer> transferCommandBuffers;
+    VkCommandPool                computeCommandPool;
+    std::vector<VkCommandBuffer> computeCommandBuffers;
+    PendingUpload                initialUpload;
+
+    bool                         properties2Extension;
+    bool                         descriptorIndexing;
+    // every allocation goes through allocateMemory, budgets from VK_EXT_memory_budget when present
+    bool                         memoryBudget;
+    // VK_KHR_maintenance2: the sampled sRGB view of the storage image of the compute mip path drops
+    // the storage usage, which sRGB formats don't support
+    bool                         viewUsage;
+    MemoryTracker                memoryTracker;
+    DescriptorManager            descriptors;
+    uint32_t                     grassTexture;
 
     VkRenderPass                 renderPass;
-    VkDescriptorSetLayout        descriptorSetLayout;
     VkPipelineLayout             pipelineLayout;
-    VkPipeline                   pipeline;
+    VkSampleCountFlagBits        msaaSamples;
+    bool                         lazyAttachments;
+    VkImage                      colorImage;
+    VkDeviceMemory               colorImageMemory;
+    VkImageView                  colorImageView;
+    VkFormat                     depthFormat;
+    VkImage                      depthImage;
+    VkDeviceMemory               depthImageMemory;
+    VkImageView                  depthImageView;
+
+    // single depth tested pass with the alpha test in the color shader
+    VkPipeline                   groundPipeline;
+    VkPipeline                   grassPipeline;
+    // depth prepass, then a color pass that only shades fragments with equal depth
+    VkPipeline                   groundDepthPipeline;
+    VkPipeline                   grassDepthPipeline;
+    VkPipeline                   groundEqualPipeline;
+    VkPipeline                   grassEqualPipeline;
+    // the same three for the blades that play the baked flutter
+    VkPipeline                   grassBakedPipeline;
+    VkPipeline                   grassBakedDepthPipeline;
+    VkPipeline                   grassBakedEqualPipeline;
+    bool                         depthPrepass;
+    bool                         prepassKeyDown;
+    SceneConstants               sceneConstants;
+    bool                         gust;
+    bool                         gustKeyDown;
+    // every pipeline built for the current render pass, keyed on shaders, state and constant values
+    std::unordered_map<std::string, PipelineVariant> pipelineVariants;
+    uint32_t                     pipelineHits;
+    uint32_t                     pipelineMisses;
+    VkPipelineCache              pipelineCache;
+
+    // shader hot reload: variants using a rebuilt binary are recreated on a worker and swapped in
+    // between frames, the old pipelines are retired to the deletion queue
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+    std::vector<std::string>     reloadPending;
+    std::future<std::vector<std::pair<std::string, VkPipeline>>> pipelineReload;
+    // objects replaced at runtime, tagged with frameIndex and destroyed once that frame has completed
+    DeletionQueue                deletionQueue;
+    DrawList                     depthDraws;
+    DrawList                     colorDraws;
+
+    // fragment shader invocations of the depth and the color pass, two queries per frame in flight
+    bool                         pipelineStatistics;
+    VkQueryPool                  statisticsPool;
+    std::vector<bool>            statisticsPending;
+    uint64_t                     prepassInvocations;
+    uint64_t                     colorInvocations;
+    uint32_t                     statisticsFrames;
+    // begin and end of the graphics and the simulation work of each frame in flight
+    bool                         timestamps;
+    float                        timestampPeriod;
+    VkQueryPool                  timestampPool;
+    std::vector<bool>            timestampsPending;
+    uint64_t                     previousGraphics[2];
+    double                       simulationMs;
+    double                       graphicsMs;
+    double                       overlapMs;
+    uint32_t                     timedFrames;
     
     float                        nFrame;
+    std::chrono::high_resolution_clock::time_point lastReport;
 
     void initResources();
     void createInstance();
@@ -147,26 +409,82 @@ private:
     void checkProperties();
     void createWindow();
     void createSwapchain();
+    void createOffscreenTargets();
+    void readBackImage(VkImage image, OffscreenFrame& result);
     void createScreenImageViews();
+    void createCapture();
+    void finishCapture();
+    void recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void collectCapture(uint32_t frame);
     void createRenderPass();
     void createGraphicsPipeline();
+    VkPipeline createPipeline(const PipelineDesc& desc);
+    VkPipeline getPipeline(const PipelineDesc& desc);
+    void createPipelineCache();
+    void destroyPipelineCache();
+    void pollShaderReload();
+    void cancelPipelineReload();
+    void createPipelineLayout();
+    // render pass, pipelines, attachments and framebuffers, everything that depends on msaaSamples
+    void createRenderTargets();
+    void retireRenderTargets();
+    void setSampleCount(VkSampleCountFlagBits samples);
+    void createAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                          VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+    void runBenchmark();
+    void createQueryPool();
+    void readStatistics(uint32_t frame);
+    void reportStatistics(std::ostream& out);
+    void readTimestamps(uint32_t frame);
+    void reportTimestamps(std::ostream& out);
+    void createSimulation();
+    void destroySimulation();
+    void recordSimulation(VkCommandBuffer commandBuffer);
+    bool submitSimulation(bool uploadSubmitted);
     void createFrameBuffer();
+    void packVertices();
     void createVertexBuffer();
     void createIndexBuffer();
     void createUniformBuffers();
+    void createInstanceBuffers();
+    void createBladePool();
+    void createWindField();
+    void updateWind(uint32_t frame);
     void createSyncObjects();
     void createCommandPool();
     void createCommandBuffers();
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
     void createDescriptorSetLayout();
     void createDescriptorSets();
-    void createDescriptorPool();
+    VkCommandBuffer beginOneTimeCommands(VkCommandPool pool);
     void copyVertices2GPU();
+    void finishInitialUpload();
     void createTexture();
+    void createVertexAnimation();
+    void generateMipmaps(VkCommandBuffer commandBuffer);
+    void generateMipmapsCompute(VkCommandBuffer commandBuffer);
     void createStagingBuffer();
     void drawFrame();
-    void updateUniformBuffer(uint32_t currentImage);
+    void updateUniformBuffer(uint32_t frame);
+    void updateInstances(uint32_t frame);
+    void updateCamera(float dt);
+    void streamField(uint32_t frame);
+    bool submitChunkUploads();
+    void recordChunkUploads(VkCommandBuffer commandBuffer);
+
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+    VkDeviceMemory allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                  MemoryCategory category);
+    void freeMemory(VkDeviceMemory memory);
+    // more than one distinct family in families makes the buffer concurrent between them
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
+                      MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& memory,
+                      std::vector<uint32_t> families = {});
 
     VkShaderModule createShaderModule(const std::vector<uint32_t>& code);
+    VkShaderModule createShaderModule(const uint32_t* code, size_t size);
+    // from the archive unless the shaders are being reloaded from disk
+    VkShaderModule loadShader(const char* filename);
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugReportCallbackFn(
     VkDebugReportFlagsEXT                       flags,
@@ -189,11 +507,17 @@ private:
 
 static void RunTimeError(const char* file, int line, const char* msg);
 
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer);
+void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer,
+                           uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred);
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, int width, int height);
 uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities);
+bool deviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* name);
+VkFormat chooseDepthFormat(VkPhysicalDevice physicalDevice);
+std::string pipelineKey(const PipelineDesc& desc);
+VkSampleCountFlags supportedSampleCounts(VkPhysicalDevice physicalDevice);
+VkSampleCountFlagBits chooseSampleCount(VkPhysicalDevice physicalDevice, uint32_t requested);
 void loadShaderModule(const char* filename, std::vector<uint32_t>& data);
 
 #undef  RUN_TIME_ERROR
@@ -0,0 +1,73 @@
+#ifndef VULKAN_HANDLE_H
+#define VULKAN_HANDLE_H
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <utility>
+
+// Move-only owner of an object created from a VkDevice, destroyed with the matching
+// vkDestroy*/vkFree* call. Objects the GPU may still use go through a DeletionQueue instead.
+template <typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+class DeviceHandle
+{
+public:
+    DeviceHandle() : device(VK_NULL_HANDLE), handle(VK_NULL_HANDLE) {}
+    DeviceHandle(VkDevice device, T handle) : device(device), handle(handle) {}
+    ~DeviceHandle() { reset(); }
+
+    DeviceHandle(const DeviceHandle&) = delete;
+    DeviceHandle& operator=(const DeviceHandle&) = delete;
+
+    DeviceHandle(DeviceHandle&& other) : device(other.device), handle(other.release()) {}
+    DeviceHandle& operator=(DeviceHandle&& other)
+    {
+        if (this != &other) {
+            reset();
+            device = other.device;
+            handle = other.release();
+        }
+        return *this;
+    }
+
+    T        get() const               { return handle; }
+    VkDevice owner() const             { return device; }
+    explicit operator bool() const     { return handle != VK_NULL_HANDLE; }
+
+    // gives up ownership without destroying
+    T release()
+    {
+        T released = handle;
+        handle = VK_NULL_HANDLE;
+        return released;
+    }
+
+    void reset(VkDevice newDevice = VK_NULL_HANDLE, T newHandle = VK_NULL_HANDLE)
+    {
+        if (handle != VK_NULL_HANDLE)
+            Destroy(device, handle, nullptr);
+        device = newDevice;
+        handle = newHandle;
+    }
+
+    static void destroy(VkDevice device, T handle) { Destroy(device, handle, nullptr); }
+
+private:
+    VkDevice device;
+    T        handle;
+};
+
+typedef DeviceHandle<VkBuffer,              vkDestroyBuffer>              UniqueBuffer;
+typedef DeviceHandle<VkDeviceMemory,        vkFreeMemory>                 UniqueMemory;
+typedef DeviceHandle<VkImage,               vkDestroyImage>               UniqueImage;
+typedef DeviceHandle<VkImageView,           vkDestroyImageView>           UniqueImageView;
+typedef DeviceHandle<VkSampler,             vkDestroySampler>             UniqueSampler;
+typedef DeviceHandle<VkFramebuffer,         vkDestroyFramebuffer>         UniqueFramebuffer;
+typedef DeviceHandle<VkRenderPass,          vkDestroyRenderPass>          UniqueRenderPass;
+typedef DeviceHandle<VkPipeline,            vkDestroyPipeline>            UniquePipeline;
+typedef DeviceHandle<VkPipelineLayout,      vkDestroyPipelineLayout>      UniquePipelineLayout;
+typedef DeviceHandle<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout> UniqueDescriptorSetLayout;
+typedef DeviceHandle<VkDescriptorPool,      vkDestroyDescriptorPool>      UniqueDescriptorPool;
+typedef DeviceHandle<VkShaderModule,        vkDestroyShaderModule>        UniqueShaderModule;
+
+#endif //VULKAN_HANDLE_H
@@ -0,0 +1,171 @@
+#include "WindField.h"
+
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIND_FIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+// the finest octave and the turbulence, cells per extent
+const uint32_t MAX_LATTICE_PERIOD = 4u << (MAX_WIND_OCTAVES - 1);
+const uint32_t TURBULENCE_PERIOD  = 16;
+// how far the gust fronts curve, in extents
+const float    GUST_BEND          = 0.1f;
+const float    TWO_PI             = 6.28318530718f;
+
+WindField::WindField(const WindFieldSettings& settings, uint32_t seed) :
+    settings(settings), updateSeconds(0.0), updates(0)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> value(0.0f, 1.0f);
+    auto makeLattice = [&random, &value](uint32_t period, float speed, float weight) {
+        Lattice lattice = { period, speed, weight, std::vector<float>(period * period) };
+        for (float& v : lattice.values)
+            v = value(random);
+        return lattice;
+    };
+
+    // each octave halves the cell size and the weight, finer detail drifts faster
+    float totalWeight = 0.0f;
+    for (uint32_t o = 0; o < settings.octaves; o++) {
+        octaves.push_back(makeLattice(4u << o, settings.scrollSpeed * (1 + o), 1.0f / (1u << o)));
+        totalWeight += octaves.back().weight;
+    }
+    for (Lattice& octave : octaves)
+        octave.weight /= totalWeight;
+    turbulence = makeLattice(TURBULENCE_PERIOD, 3.0f * settings.scrollSpeed, 1.0f);
+}
+
+void WindField::update(JobSystem& jobs, float time, glm::vec2* texels)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    jobs.parallelFor(WIND_FIELD_SIZE, 8, [this, time, texels](uint32_t begin, uint32_t end) {
+        updateRows(time, begin, end, texels);
+    });
+    updateSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    updates++;
+}
+
+void WindField::report(std::ostream& out)
+{
+    if (updates == 0)
+        return;
+    double ms = updateSeconds * 1000.0 / updates;
+    out << "Wind field: " << WIND_FIELD_SIZE << "x" << WIND_FIELD_SIZE << ", " << ms << " ms/update, "
+        << ms * 1e6 / (WIND_FIELD_SIZE * WIND_FIELD_SIZE) << " ns/texel"
+#ifdef WIND_FIELD_SSE2
+        << " (sse2)"
+#endif
+        << std::endl;
+    updateSeconds = 0.0;
+    updates = 0;
+}
+
+static float smooth(float f)
+{
+    return f * f * (3.0f - 2.0f * f);
+}
+
+// the lattice interpolated along z at one texel row, row[period] repeats row[0] so x needs no wrap
+static void latticeRow(const std::vector<float>& values, uint32_t period, float v, float* row)
+{
+    uint32_t i0 = uint32_t(v) & (period - 1);
+    uint32_t i1 = (i0 + 1) & (period - 1);
+    float f = smooth(v - std::floor(v));
+    for (uint32_t k = 0; k < period; k++)
+        row[k] = values[i0 * period + k] + (values[i1 * period + k] - values[i0 * period + k]) * f;
+    row[period] = row[0];
+}
+
+void WindField::updateRows(float time, uint32_t begin, uint32_t end, glm::vec2* texels) const
+{
+    const uint32_t octaveCount = uint32_t(octaves.size());
+    const float extent = settings.extent;
+    const float texel  = extent / WIND_FIELD_SIZE;
+    // offsets wrap at the extent, the field repeats anyway and the floats keep their precision
+    float scroll[MAX_WIND_OCTAVES];
+    for (uint32_t o = 0; o < octaveCount; o++)
+        scroll[o] = float(std::fmod(double(time) * octaves[o].speed, double(extent)));
+    const float turbulenceScroll = float(std::fmod(double(time) * turbulence.speed, double(extent)));
+    const float gustOffset       = float(std::fmod(double(time) * settings.gustSpeed, double(extent)));
+    const float gustScale        = extent / settings.gustWidth;
+    const float gustStrength     = settings.gustStrength;
+
+    float rows[MAX_WIND_OCTAVES][MAX_LATTICE_PERIOD + 1];
+    float turbulenceRow[TURBULENCE_PERIOD + 1];
+    for (uint32_t z = begin; z < end; z++) {
+        // noise only scrolls along x, so the z interpolation is shared by the whole row
+        float worldZ = (z + 0.5f) * texel;
+        for (uint32_t o = 0; o < octaveCount; o++)
+            latticeRow(octaves[o].values, octaves[o].period, worldZ / extent * octaves[o].period, rows[o]);
+        latticeRow(turbulence.values, turbulence.period, worldZ / extent * turbulence.period, turbulenceRow);
+        // the fronts bend along z, +2 keeps the gust phase positive
+        const float bend = GUST_BEND * std::sin(TWO_PI * worldZ / extent) + 2.0f;
+        glm::vec2* out = texels + z * WIND_FIELD_SIZE;
+
+#ifdef WIND_FIELD_SSE2
+        // four texels of the row at a time, only the lattice reads are scalar
+        alignas(16) int32_t index[4];
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f);
+        auto sampleRow = [&index, three](const float* row, uint32_t period, float offset, __m128 x) {
+            // x - offset is above -WIND_FIELD_SIZE, adding the period keeps u positive so truncation floors it
+            __m128 u = _mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(offset)), _mm_set1_ps(float(period) / WIND_FIELD_SIZE));
+            u = _mm_add_ps(u, _mm_set1_ps(float(period)));
+            __m128i i = _mm_cvttps_epi32(u);
+            __m128 f = _mm_sub_ps(u, _mm_cvtepi32_ps(i));
+            f = _mm_mul_ps(_mm_mul_ps(f, f), _mm_sub_ps(three, _mm_add_ps(f, f)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_and_si128(i, _mm_set1_epi32(int32_t(period - 1))));
+            __m128 a = _mm_setr_ps(row[index[0]], row[index[1]], row[index[2]], row[index[3]]);
+            __m128 b = _mm_setr_ps(row[index[0] + 1], row[index[1] + 1], row[index[2] + 1], row[index[3] + 1]);
+            return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+        };
+        for (uint32_t x = 0; x < WIND_FIELD_SIZE; x += 4) {
+            // in texels, the offsets are converted to match
+            __m128 column = _mm_setr_ps(x + 0.5f, x + 1.5f, x + 2.5f, x + 3.5f);
+            __m128 noise = _mm_setzero_ps();
+            for (uint32_t o = 0; o < octaveCount; o++) {
+                __m128 v = sampleRow(rows[o], octaves[o].period, scroll[o] / texel, column);
+                noise = _mm_add_ps(noise, _mm_mul_ps(v, _mm_set1_ps(octaves[o].weight)));
+            }
+            __m128 swirl = sampleRow(turbulenceRow, turbulence.period, turbulenceScroll / texel, column);
+
+            // distance behind the last front in gust widths, the gust peaks one width behind it
+            __m128 phase = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(gustOffset / texel), column),
+                                                 _mm_set1_ps(1.0f / WIND_FIELD_SIZE)), _mm_set1_ps(bend));
+            __m128 behind = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+            __m128 w = _mm_mul_ps(behind, _mm_set1_ps(gustScale));
+            __m128 g = _mm_div_ps(_mm_mul_ps(two, w), _mm_add_ps(one, _mm_mul_ps(w, w)));
+            g = _mm_mul_ps(g, g);
+
+            __m128 strength = _mm_add_ps(_mm_mul_ps(noise, _mm_set1_ps(1.0f - gustStrength)), _mm_mul_ps(g, _mm_set1_ps(gustStrength)));
+            __m128 swirlSigned = _mm_sub_ps(_mm_mul_ps(swirl, two), one);
+            float* dst = &out[x].x;
+            _mm_storeu_ps(dst, _mm_unpacklo_ps(strength, swirlSigned));
+            _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(strength, swirlSigned));
+        }
+#else
+        auto sampleRow = [](const float* row, uint32_t period, float offset, float x) {
+            float u = (x - offset) * float(period) / WIND_FIELD_SIZE + float(period);
+            uint32_t i = uint32_t(u);
+            float f = smooth(u - float(i));
+            i &= period - 1;
+            return row[i] + (row[i + 1] - row[i]) * f;
+        };
+        for (uint32_t x = 0; x < WIND_FIELD_SIZE; x++) {
+            float column = x + 0.5f;
+            float noise = 0.0f;
+            for (uint32_t o = 0; o < octaveCount; o++)
+                noise += sampleRow(rows[o], octaves[o].period, scroll[o] / texel, column) * octaves[o].weight;
+            float swirl = sampleRow(turbulenceRow, turbulence.period, turbulenceScroll / texel, column);
+
+            float phase = (gustOffset / texel - column) / WIND_FIELD_SIZE + bend;
+            float w = (phase - std::floor(phase)) * gustScale;
+            float g = 2.0f * w / (1.0f + w * w);
+            out[x] = glm::vec2(noise * (1.0f - gustStrength) + g * g * gustStrength, 2.0f * swirl - 1.0f);
+        }
+#endif
+    }
+}
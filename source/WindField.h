@@ -0,0 +1,63 @@
+#ifndef WIND_FIELD_H
+#define WIND_FIELD_H
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+// texels per side, a power of two so the shaders wrap with a mask (vertex.vert, simulate.comp)
+const uint32_t WIND_FIELD_SIZE = 64;
+const uint32_t MAX_WIND_OCTAVES = 4;
+
+// times are in frames like the rest of the wind, distances in world units
+struct WindFieldSettings
+{
+    float    extent       = 32.0f;  // ground covered by the field, it repeats beyond
+    float    scrollSpeed  = 0.01f;  // drift of the coarsest noise octave along +x per frame
+    uint32_t octaves      = 3;
+    float    gustSpeed    = 0.06f;  // gust fronts travel along +x, one front per extent
+    float    gustWidth    = 2.0f;   // distance behind a front where its gust peaks
+    float    gustStrength = 0.6f;   // share of the strength that comes from the gusts
+};
+
+// Spatially coherent wind for every blade at a cost that does not depend on the blade count:
+// scrolling value noise plus gust fronts, evaluated once per frame into a small field that the
+// shaders sample bilinearly at each blade's world position. Texel (x, z) holds the strength
+// (0 to 1, how far the blades are pushed over) and the turbulence (-1 to 1, shifts the flutter).
+class WindField
+{
+public:
+    explicit WindField(const WindFieldSettings& settings, uint32_t seed = 1);
+
+    // writes WIND_FIELD_SIZE * WIND_FIELD_SIZE texels, rows along +z, split into jobs by rows
+    void  update(JobSystem& jobs, float time, glm::vec2* texels);
+    // field repeats per world unit, the shaders scale world positions by it
+    float scale() const { return 1.0f / settings.extent; }
+    // average update time since the last report
+    void  report(std::ostream& out);
+
+private:
+    struct Lattice
+    {
+        uint32_t           period; // cells per extent
+        float              speed;  // scroll along +x per frame
+        float              weight;
+        std::vector<float> values; // period * period random values in [0, 1)
+    };
+
+    WindFieldSettings    settings;
+    std::vector<Lattice> octaves;
+    Lattice              turbulence;
+    double               updateSeconds;
+    uint32_t             updates;
+
+    void updateRows(float time, uint32_t begin, uint32_t end, glm::vec2* texels) const;
+};
+
+#endif //WIND_FIELD_H
@@ -1,10 +1,70 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #include "VulkanApp.h"
+#include "JobSystem.h"
+#include "GrassField.h"
+#include "NumberReader.h"
 
-int main()
+// chunk placement over a 64x64 chunk area, the same work the field streams in
+static void runJobBenchmark()
 {
-    VulkanApp app;
+    const uint32_t side = 64;
+    const uint32_t species = 3;
+    const FieldConfig field;
+    std::vector<std::vector<BladeInstance>> chunks(side * side);
+    benchmarkJobScaling(std::cout, side * side, 16, [&chunks, &field](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            ChunkCoord coord = { int32_t(i % side) - int32_t(side / 2), int32_t(i / side) - int32_t(side / 2) };
+            generateChunk(coord, species, field.bladesPerSide, chunks[i]);
+        }
+    });
+}
+
+int main(int argc, char** argv)
+{
+    AppOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            options.samples = uint32_t(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            options.benchmark = true;
+        else if (strcmp(argv[i], "--dev") == 0)
+            options.shaderReload = true;
+        else if (strcmp(argv[i], "--sync-compute") == 0)
+            options.asyncCompute = false;
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            options.scenePath = argv[++i]; // "" for the built-in scene
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+            options.archivePath = argv[++i]; // "" to read the loose files
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            options.capturePath = argv[++i]; // "<name>.y4m" or a directory for ppm frames
+        else if (strcmp(argv[i], "--capture-fps") == 0 && i + 1 < argc)
+            options.captureFps = uint32_t(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--vat-lod") == 0 && i + 1 < argc)
+            options.vertexAnimationLod = uint32_t(std::max(0, atoi(argv[++i]))); // 0 plays every lod back
+        else if (strcmp(argv[i], "--stats") == 0)
+            options.stats = true;
+        else if (strcmp(argv[i], "--job-benchmark") == 0) {
+            runJobBenchmark();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--parse-benchmark") == 0 && i + 1 < argc) {
+            // any text file of whitespace separated floats, e.g. a large exported mesh
+            JobSystem jobs;
+            std::vector<float> values;
+            NumberReadStats stats;
+            readNumbers(jobs, argv[++i], values, &stats);
+            std::cout << argv[i] << ": " << stats.values << " values, " << stats.bytes / (1024.0 * 1024.0) << " MiB in " 
+                      << stats.chunks << " chunks, " << stats.seconds * 1000.0 << " ms, " << stats.megabytesPerSecond() 
+                      << " MB/s with " << jobs.threadCount() << " threads" << std::endl;
+            return 0;
+        }
+    }
+
+    VulkanApp app(options);
     std::cout << "ddd";
     app.Init();
     app.Run();
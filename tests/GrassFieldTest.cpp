@@ -0,0 +1,56 @@
+// grass_field_test
+// Chunk generation has to be deterministic per chunk and differ between chunks: a seed that loses
+// one of the coordinates makes whole rows of chunks identical and sway in lockstep.
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "GrassField.h"
+
+const uint32_t SPECIES         = 4;
+const uint32_t BLADES_PER_SIDE = 8;
+
+// the blades relative to their chunk, equal layouts would look the same wherever the chunk is
+static bool sameBlades(const ChunkCoord& a, const std::vector<BladeInstance>& bladesA,
+                       const ChunkCoord& b, const std::vector<BladeInstance>& bladesB)
+{
+    for (size_t i = 0; i < bladesA.size(); i++) {
+        float ax = bladesA[i].x - a.x * CHUNK_SIZE, az = bladesA[i].z - a.z * CHUNK_SIZE;
+        float bx = bladesB[i].x - b.x * CHUNK_SIZE, bz = bladesB[i].z - b.z * CHUNK_SIZE;
+        if (std::fabs(ax - bx) > 1e-4f || std::fabs(az - bz) > 1e-4f || bladesA[i].scale != bladesB[i].scale ||
+            bladesA[i].variation != bladesB[i].variation)
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    int failed = 0;
+    std::vector<ChunkCoord> coords;
+    for (int32_t z = -2; z <= 2; z++)
+        for (int32_t x = -2; x <= 2; x++)
+            coords.push_back({ x, z });
+
+    std::vector<std::vector<BladeInstance>> chunks(coords.size());
+    for (size_t i = 0; i < coords.size(); i++) {
+        generateChunk(coords[i], SPECIES, BLADES_PER_SIDE, chunks[i]);
+        std::vector<BladeInstance> again;
+        generateChunk(coords[i], SPECIES, BLADES_PER_SIDE, again);
+        if (!sameBlades(coords[i], chunks[i], coords[i], again)) {
+            std::cout << "chunk (" << coords[i].x << ", " << coords[i].z << ") is not deterministic" << std::endl;
+            failed++;
+        }
+    }
+    for (size_t i = 0; i < coords.size(); i++) {
+        for (size_t j = i + 1; j < coords.size(); j++) {
+            if (sameBlades(coords[i], chunks[i], coords[j], chunks[j])) {
+                std::cout << "chunks (" << coords[i].x << ", " << coords[i].z << ") and (" << coords[j].x << ", "
+                          << coords[j].z << ") generate the same blades" << std::endl;
+                failed++;
+            }
+        }
+    }
+    std::cout << "grass_field_test: " << coords.size() << " chunks, " << failed << " failures" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+// render_test [--golden <dir>] [--output <dir>] [--update] [--frames N]
+//             [--channel-tolerance N] [--pixel-tolerance F] [--time-threshold F] [--count-threshold F]
+// Renders every case headless, compares the last frame against <golden>/<case>.ppm and the measured
+// numbers against <golden>/<case>.perf. A case without a golden image or baseline fails after writing
+// what it rendered to <output>, an unchecked case must not pass; --update writes them to <golden> instead.
+// Meant for a machine without a GPU: VK_ICD_FILENAMES pointing at lavapipe selects the software driver.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include "VulkanApp.h"
+
+struct TestCase
+{
+    const char* name;
+    uint32_t    samples;
+};
+
+// single sampled first, it does not depend on how the driver places msaa samples
+const TestCase TEST_CASES[] = {
+    { "default",       1 },
+    { "default_msaa4", 4 },
+};
+
+struct TestSettings
+{
+    std::string golden           = "../tests/golden";
+    std::string output           = "render_test";
+    bool        update           = false;
+    uint32_t    frames           = 60;
+    uint32_t    channelTolerance = 8;      // per channel difference a pixel may have and still match
+    double      pixelTolerance   = 0.002;  // fraction of pixels that may differ
+    double      timeThreshold    = 0.25;   // frame times may grow by this fraction
+    double      countThreshold   = 0.02;   // fragment invocations may grow by this fraction
+};
+
+static bool readPpm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    uint32_t maxValue = 0;
+    if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255)
+        return false;
+    file.get();
+    rgb.resize(size_t(width) * height * 3);
+    file.read(reinterpret_cast<char*>(rgb.data()), std::streamsize(rgb.size()));
+    return bool(file);
+}
+
+static void writePpm(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgb)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb.data()), std::streamsize(rgb.size()));
+    if (!file)
+        throw std::runtime_error("writePpm: failed to write " + path);
+}
+
+// "name value" per line
+static std::map<std::string, double> readPerf(const std::string& path)
+{
+    std::map<std::string, double> values;
+    std::ifstream file(path);
+    std::string name;
+    double value;
+    while (file >> name >> value)
+        values[name] = value;
+    return values;
+}
+
+static void writePerf(const std::string& path, const std::map<std::string, double>& values)
+{
+    std::ofstream file(path);
+    for (const auto& value : values)
+        file << value.first << " " << value.second << "\n";
+    if (!file)
+        throw std::runtime_error("writePerf: failed to write " + path);
+}
+
+// fails on a size mismatch or too many differing pixels, writes the differences as an image
+static bool compareImages(const OffscreenFrame& frame, const std::string& goldenPath, const std::string& diffPath,
+                          const TestSettings& settings)
+{
+    uint32_t width, height;
+    std::vector<uint8_t> golden;
+    if (!readPpm(goldenPath, width, height, golden)) {
+        std::cout << "  image: " << goldenPath << " is not a binary 8 bit ppm" << std::endl;
+        return false;
+    }
+    if (width != frame.width || height != frame.height) {
+        std::cout << "  image: " << frame.width << "x" << frame.height << ", golden is " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> diff(golden.size(), 0);
+    uint64_t differing = 0;
+    double squared = 0.0;
+    for (size_t pixel = 0; pixel < size_t(width) * height; pixel++) {
+        uint32_t largest = 0;
+        for (size_t c = 3 * pixel; c < 3 * pixel + 3; c++) {
+            uint32_t d = uint32_t(std::abs(int(frame.rgb[c]) - int(golden[c])));
+            largest = std::max(largest, d);
+            squared += double(d) * d;
+            diff[c] = uint8_t(std::min(255u, d * 8));
+        }
+        differing += largest > settings.channelTolerance;
+    }
+    double fraction = double(differing) / (double(width) * height);
+    double rmse = std::sqrt(squared / golden.size());
+    bool pass = fraction <= settings.pixelTolerance;
+    std::cout << "  image: " << differing << " pixels differ by more than " << settings.channelTolerance << " ("
+              << fraction * 100.0 << "%, limit " << settings.pixelTolerance * 100.0 << "%), rmse " << rmse
+              << (pass ? "" : ", FAILED") << std::endl;
+    if (!pass)
+        writePpm(diffPath, width, height, diff);
+    return pass;
+}
+
+// only growth fails, getting faster is not a regression
+static bool comparePerf(const std::map<std::string, double>& measured, const std::map<std::string, double>& baseline,
+                        const TestSettings& settings)
+{
+    bool pass = true;
+    for (const auto& value : measured) {
+        auto it = baseline.find(value.first);
+        if (it == baseline.end() || it->second <= 0.0 || value.second <= 0.0)
+            continue;
+        bool count = value.first == "fragmentInvocations";
+        double threshold = count ? settings.countThreshold : settings.timeThreshold;
+        double change = value.second / it->second - 1.0;
+        bool ok = change <= threshold;
+        std::cout << "  " << value.first << ": " << value.second << ", baseline " << it->second << ", "
+                  << (change >= 0.0 ? "+" : "") << change * 100.0 << "% (limit +" << threshold * 100.0 << "%)"
+                  << (ok ? "" : ", FAILED") << std::endl;
+        pass = pass && ok;
+    }
+    return pass;
+}
+
+// false when the images or numbers differ, or there is nothing to compare them with
+static bool runCase(const TestCase& test, const TestSettings& settings)
+{
+    AppOptions options;
+    options.headless     = true;
+    options.samples      = test.samples;
+    options.shaderReload = false;
+
+    OffscreenFrame frame;
+    {
+        VulkanApp app(options);
+        app.Init();
+        app.RenderOffscreen(settings.frames, frame);
+    }
+    std::cout << test.name << ": " << frame.width << "x" << frame.height << ", settled after " << frame.settleFrames
+              << " frames, " << frame.cpuMsPerFrame << " ms/frame cpu, " << frame.gpuMsPerFrame << " ms/frame gpu, "
+              << frame.fragmentInvocations << " fragment invocations/frame" << std::endl;
+
+    std::map<std::string, double> measured = {
+        { "cpuMsPerFrame",       frame.cpuMsPerFrame },
+        { "gpuMsPerFrame",       frame.gpuMsPerFrame },
+        { "fragmentInvocations", frame.fragmentInvocations },
+    };
+    std::string goldenImage = settings.golden + "/" + test.name + ".ppm";
+    std::string goldenPerf  = settings.golden + "/" + test.name + ".perf";
+    if (settings.update) {
+        writePpm(goldenImage, frame.width, frame.height, frame.rgb);
+        writePerf(goldenPerf, measured);
+        std::cout << "  updated " << goldenImage << " and " << goldenPerf << std::endl;
+        return true;
+    }
+
+    std::string outputBase = settings.output + "/" + test.name;
+    writePpm(outputBase + ".ppm", frame.width, frame.height, frame.rgb);
+    writePerf(outputBase + ".perf", measured);
+    std::map<std::string, double> baseline = readPerf(goldenPerf);
+    if (!std::ifstream(goldenImage).good() || baseline.empty()) {
+        std::cout << "  no golden image or baseline in " << settings.golden << ", rendered to " << outputBase
+                  << ".ppm; rerun with --update on the reference machine to record them, FAILED" << std::endl;
+        return false;
+    }
+    bool image = compareImages(frame, goldenImage, outputBase + ".diff.ppm", settings);
+    bool perf  = comparePerf(measured, baseline, settings);
+    return image && perf;
+}
+
+int main(int argc, char** argv)
+{
+    TestSettings settings;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            settings.golden = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            settings.output = argv[++i];
+        else if (strcmp(argv[i], "--update") == 0)
+            settings.update = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            settings.frames = uint32_t(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--channel-tolerance") == 0 && i + 1 < argc)
+            settings.channelTolerance = uint32_t(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--pixel-tolerance") == 0 && i + 1 < argc)
+            settings.pixelTolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--time-threshold") == 0 && i + 1 < argc)
+            settings.timeThreshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--count-threshold") == 0 && i + 1 < argc)
+            settings.countThreshold = atof(argv[++i]);
+        else {
+            std::cerr << "render_test: unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    try {
+        std::filesystem::create_directories(settings.update ? settings.golden : settings.output);
+        for (const TestCase& test : TEST_CASES)
+            failed += runCase(test, settings) ? 0 : 1;
+    } catch (const std::exception& error) {
+        std::cerr << "render_test: " << error.what() << std::endl;
+        return 1;
+    }
+    int total = int(sizeof(TEST_CASES) / sizeof(TEST_CASES[0]));
+    std::cout << "render_test: " << total - failed << " passed, " << failed << " failed" << std::endl;
+    return failed > 0 ? 1 : 0;
+}